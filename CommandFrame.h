@@ -0,0 +1,110 @@
+// CommandFrame.h - Compact binary lift command frame shared by the HMI and the motor controller
+//
+// A single 24-byte frame carries a command over MQTT (the unit's CMD_FRAME_TOPIC) and, when
+// CMD_FRAME_ESPNOW is set, also over ESP-NOW. Every frame has a per-sender sequence number
+// and the sender's wall-clock send time. The motor controller answers each frame with an ack
+// in the same layout, sent on CMD_ACK_TOPIC or back to the ESP-NOW sender. Frames that repeat
+// or precede the newest sequence from a sender are acknowledged but not executed, so the copy
+// of a frame that arrives second over the other transport is acked as a duplicate.
+//
+// ESP-NOW is off by default: the link is unauthenticated, so any board in radio range could
+// move the lift. Both builds read CMD_FRAME_ESPNOW from here, so define it to 1 for the HMI
+// and the motor controller together. The controller then listens for frames and publishes
+// its station MAC (retained) on CMD_ESPNOW_TOPIC, and the HMI sends every frame to that
+// address as well as over MQTT.
+//
+// Plain C so it can be included from the ESP-IDF HMI as well as the Arduino sketch. Fields
+// are little-endian, which is native on both ESP32 targets.
+
+#ifndef COMMAND_FRAME_H
+#define COMMAND_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CMD_FRAME_MAGIC   0xC7
+#define CMD_FRAME_VERSION 1
+#define CMD_FRAME_TOPIC   "usf/cmd/frame"
+#define CMD_ACK_TOPIC     "usf/cmd/ack"
+#define CMD_ESPNOW_TOPIC  "usf/cmd/espnow"  // Controller's ESP-NOW MAC, 6 bytes, retained
+
+#ifndef CMD_FRAME_ESPNOW
+#define CMD_FRAME_ESPNOW 0  // 1: frames over ESP-NOW too, on both the HMI and the controller
+#endif
+
+// Opcodes
+#define CMD_OP_STOP          0x01
+#define CMD_OP_UP            0x02
+#define CMD_OP_DOWN          0x03
+#define CMD_OP_BRAKE         0x04
+#define CMD_OP_RELEASE_BRAKE 0x05
+#define CMD_OP_STOP_UP       0x06
+#define CMD_OP_STOP_DOWN     0x07
+#define CMD_OP_ACK           0x80
+
+// Ack status
+#define CMD_STATUS_OK        0
+#define CMD_STATUS_DUPLICATE 1  // Same sequence as the newest frame; already executed
+#define CMD_STATUS_STALE     2  // Older than the newest frame; dropped so it cannot undo a later command
+#define CMD_STATUS_UNKNOWN   3  // Opcode not supported
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t opcode;
+    uint8_t status;       // Ack only: CMD_STATUS_*
+    uint32_t sender_id;   // Random per sender boot, so a restart never looks like a replay
+    uint32_t sequence;    // Per sender, starts at 1
+    uint32_t handled_us;  // Ack only: frame received -> relay output driven on the controller
+    uint64_t sent_us;     // Sender wall clock in microseconds since the epoch; echoed in the ack
+} command_frame_t;
+
+static inline void cmd_frame_init(command_frame_t *frame, uint8_t opcode, uint32_t sender_id,
+                                  uint32_t sequence, uint64_t sent_us) {
+    memset(frame, 0, sizeof(*frame));
+    frame->magic = CMD_FRAME_MAGIC;
+    frame->version = CMD_FRAME_VERSION;
+    frame->opcode = opcode;
+    frame->sender_id = sender_id;
+    frame->sequence = sequence;
+    frame->sent_us = sent_us;
+}
+
+// True when data holds a frame of this version (command or ack)
+static inline bool cmd_frame_valid(const uint8_t *data, int len) {
+    return len == (int)sizeof(command_frame_t) && data[0] == CMD_FRAME_MAGIC &&
+           data[1] == CMD_FRAME_VERSION;
+}
+
+static inline void cmd_frame_make_ack(command_frame_t *ack, const command_frame_t *frame,
+                                      uint8_t status, uint32_t handled_us) {
+    cmd_frame_init(ack, CMD_OP_ACK, frame->sender_id, frame->sequence, frame->sent_us);
+    ack->status = status;
+    ack->handled_us = handled_us;
+}
+
+static inline const char *cmd_opcode_name(uint8_t opcode) {
+    switch (opcode) {
+        case CMD_OP_STOP:          return "STOP";
+        case CMD_OP_UP:            return "UP";
+        case CMD_OP_DOWN:          return "DOWN";
+        case CMD_OP_BRAKE:         return "BRAKE";
+        case CMD_OP_RELEASE_BRAKE: return "RELEASE_BRAKE";
+        case CMD_OP_STOP_UP:       return "STOP_UP";
+        case CMD_OP_STOP_DOWN:     return "STOP_DOWN";
+        case CMD_OP_ACK:           return "ACK";
+        default:                   return "UNKNOWN";
+    }
+}
+
+static inline const char *cmd_status_name(uint8_t status) {
+    switch (status) {
+        case CMD_STATUS_OK:        return "ok";
+        case CMD_STATUS_DUPLICATE: return "duplicate";
+        case CMD_STATUS_STALE:     return "stale";
+        default:                   return "unknown";
+    }
+}
+
+#endif // COMMAND_FRAME_H
@@ -0,0 +1,154 @@
+// CommandStats.h - Sequence filtering and latency histograms for command frames
+//
+// CommandSequencer tracks the newest sequence number per sender so repeated or reordered
+// frames are never executed. LatencyHistogram is a fixed-size log-linear histogram
+// (8 sub-buckets per power of two, about 12% resolution) for command latency percentiles.
+//
+// No Arduino dependencies; callers provide locking.
+
+#ifndef COMMAND_STATS_H
+#define COMMAND_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CMD_SEQUENCER_SENDERS 8  // Senders tracked at once; the least recently seen is replaced
+
+enum class CommandTransport : uint8_t {
+  Mqtt = 0,
+  EspNow = 1
+};
+#define CMD_TRANSPORT_COUNT 2
+
+inline const char* commandTransportName(CommandTransport transport) {
+  return transport == CommandTransport::Mqtt ? "mqtt" : "espnow";
+}
+
+enum class SequenceCheck : uint8_t {
+  Accept,
+  Duplicate,  // Same as the newest sequence from this sender
+  Stale       // Older than the newest sequence from this sender
+};
+
+struct CommandTransportStats {
+  uint32_t frames;      // Valid command frames received
+  uint32_t executed;
+  uint32_t duplicates;
+  uint32_t stale;
+  uint32_t unknown;     // Unsupported opcodes
+  uint32_t clockSkew;   // Latency samples dropped because the sender clock was ahead
+};
+
+// ===== Sequence filter ===== //
+
+class CommandSequencer {
+ public:
+  SequenceCheck check(uint32_t senderId, uint32_t sequence) {
+    Sender& s = senderFor(senderId);
+    if (!s.active) {
+      s.active = true;
+      s.senderId = senderId;
+      s.newest = sequence;
+      return SequenceCheck::Accept;
+    }
+    if ((int32_t)(sequence - s.newest) > 0) {
+      s.newest = sequence;
+      return SequenceCheck::Accept;
+    }
+    return sequence == s.newest ? SequenceCheck::Duplicate : SequenceCheck::Stale;
+  }
+
+ private:
+  struct Sender {
+    uint32_t senderId;
+    uint32_t newest;
+    uint32_t lastUsed;
+    bool active;
+  };
+
+  Sender senders[CMD_SEQUENCER_SENDERS] = {};
+  uint32_t useCounter = 0;
+
+  Sender& senderFor(uint32_t senderId) {
+    int victim = 0;
+    for (int i = 0; i < CMD_SEQUENCER_SENDERS; i++) {
+      if (senders[i].active && senders[i].senderId == senderId) {
+        senders[i].lastUsed = ++useCounter;
+        return senders[i];
+      }
+      if (!senders[i].active || senders[i].lastUsed < senders[victim].lastUsed) victim = i;
+    }
+    senders[victim].active = false;
+    senders[victim].lastUsed = ++useCounter;
+    return senders[victim];
+  }
+};
+
+// ===== Latency histogram ===== //
+
+#define LATENCY_SUB_BITS 3     // 8 sub-buckets per power of two
+#define LATENCY_MIN_SHIFT 6    // First bucket holds 0-63 us
+#define LATENCY_OCTAVES 21     // Last bucket starts at 2^27 us (~134 s)
+#define LATENCY_BUCKETS (1 + (LATENCY_OCTAVES << LATENCY_SUB_BITS))
+
+class LatencyHistogram {
+ public:
+  void record(uint32_t us) {
+    counts[bucketOf(us)]++;
+    samples++;
+    sumUs += us;
+    if (us > maxUs) maxUs = us;
+  }
+
+  // Upper bound of the bucket holding the pct-th percentile, capped at the largest sample
+  uint32_t percentile(uint32_t pct) const {
+    if (samples == 0) return 0;
+    uint64_t rank = ((uint64_t)samples * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+        uint32_t bound = upperBound(i);
+        return bound < maxUs ? bound : maxUs;
+      }
+    }
+    return maxUs;
+  }
+
+  uint32_t count() const { return samples; }
+  uint32_t max() const { return maxUs; }
+  uint32_t mean() const { return samples ? (uint32_t)(sumUs / samples) : 0; }
+
+  void reset() {
+    memset(counts, 0, sizeof(counts));
+    samples = 0;
+    sumUs = 0;
+    maxUs = 0;
+  }
+
+ private:
+  uint32_t counts[LATENCY_BUCKETS] = {};
+  uint32_t samples = 0;
+  uint64_t sumUs = 0;
+  uint32_t maxUs = 0;
+
+  static int bucketOf(uint32_t us) {
+    if (us < (1u << LATENCY_MIN_SHIFT)) return 0;
+    int exponent = 31 - __builtin_clz(us);
+    if (exponent >= LATENCY_MIN_SHIFT + LATENCY_OCTAVES) return LATENCY_BUCKETS - 1;
+    int sub = (us >> (exponent - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+    return 1 + ((exponent - LATENCY_MIN_SHIFT) << LATENCY_SUB_BITS) + sub;
+  }
+
+  static uint32_t upperBound(int bucket) {
+    if (bucket == 0) return (1u << LATENCY_MIN_SHIFT) - 1;
+    if (bucket == LATENCY_BUCKETS - 1) return UINT32_MAX;
+    int exponent = LATENCY_MIN_SHIFT + ((bucket - 1) >> LATENCY_SUB_BITS);
+    uint32_t sub = (bucket - 1) & ((1 << LATENCY_SUB_BITS) - 1);
+    return (((1u << LATENCY_SUB_BITS) + sub + 1) << (exponent - LATENCY_SUB_BITS)) - 1;
+  }
+};
+
+#endif // COMMAND_STATS_H
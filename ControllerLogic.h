@@ -0,0 +1,356 @@
+// ControllerLogic.h - Buttons, LED alarm handling, relay outputs and loop timing
+//
+// Nothing here reads a pin or a clock: callers pass the reading and the time, and the
+// outputs go to a caller's type (pins and MQTT in the sketch). The same code that runs in
+// loop() and commandTask can then be driven in virtual time off-device, e.g. to replay a
+// scripted LED and button timeline deterministically (tests/ScenarioRunner.cpp).
+//
+// No Arduino dependencies; callers provide locking.
+
+#ifndef CONTROLLER_LOGIC_H
+#define CONTROLLER_LOGIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include "LEDAlarmDecoder.h"
+#include "CommandFrame.h"
+#include "CommandStats.h"
+
+#define BUTTON_DEBOUNCE_MS 50      // Up/down button debounce
+#define ALERT_COOLDOWN 5000        // 5 seconds between publishes of one alert class
+#define ALERT_DEBOUNCE_TIME 1000   // 1 second debounce for state changes
+#define ALERT_REFRESH_MS 250       // Re-check period while the LEDs show an alarm
+#define RELAY_REVERSE_DEADTIME_US 10000  // Both outputs of a pair off before reversing
+#define LED_STATUS_LINES_SIZE 192  // "Red LED 0: FLASHING\n..." for all eight LEDs
+#define LED_STATUS_SUMMARY_SIZE 64
+
+// ===== Button debounce ===== //
+
+enum class ButtonEvent : uint8_t {
+  None,
+  Pressed,
+  Released
+};
+
+// Active-low push button: a reading counts once it has held for longer than debounceMs
+class ButtonDebouncer {
+ public:
+  explicit ButtonDebouncer(uint32_t debounceMs) : debounceMs(debounceMs) {}
+
+  ButtonEvent update(bool reading, uint32_t nowMs) {
+    if (reading != lastReading) {
+      lastReading = reading;
+      lastChangeMs = nowMs;
+    }
+    if (nowMs - lastChangeMs <= debounceMs || reading == stableReading) return ButtonEvent::None;
+
+    stableReading = reading;
+    if (!reading && !pressed) {
+      pressed = true;
+      return ButtonEvent::Pressed;
+    }
+    if (reading && pressed) {
+      pressed = false;
+      return ButtonEvent::Released;
+    }
+    return ButtonEvent::None;
+  }
+
+ private:
+  uint32_t debounceMs;
+  uint32_t lastChangeMs = 0;
+  bool lastReading = true;    // Released (HIGH)
+  bool stableReading = true;
+  bool pressed = false;
+};
+
+// The up and down buttons: a press moves, a release stops in lift mode, and elevator mode
+// latches the movement until a stop. command() gets CMD_OP_UP, CMD_OP_DOWN or CMD_OP_STOP.
+class ButtonPanel {
+ public:
+  explicit ButtonPanel(uint32_t debounceMs) : up(debounceMs), down(debounceMs) {}
+
+  template <typename Command>
+  void update(bool upReading, bool downReading, bool elevatorMode, uint32_t nowMs, Command command) {
+    ButtonEvent upEvent = up.update(upReading, nowMs);
+    ButtonEvent downEvent = down.update(downReading, nowMs);
+    if (upEvent == ButtonEvent::Pressed) {
+      command(CMD_OP_UP);
+    } else if (upEvent == ButtonEvent::Released && !elevatorMode) {
+      command(CMD_OP_STOP);
+    }
+    if (downEvent == ButtonEvent::Pressed) {
+      command(CMD_OP_DOWN);
+    } else if (downEvent == ButtonEvent::Released && !elevatorMode) {
+      command(CMD_OP_STOP);
+    }
+  }
+
+ private:
+  ButtonDebouncer up;
+  ButtonDebouncer down;
+};
+
+// ===== Alarm publish gate ===== //
+
+// Publishes an alarm class once its code has been stable for ALERT_DEBOUNCE_TIME and seen
+// again since, and not more often than every ALERT_COOLDOWN
+class AlertGate {
+ public:
+  bool update(AlarmCode newCode, uint32_t nowMs) {
+    if (newCode != code) {
+      code = newCode;
+      lastChangeMs = nowMs;
+      stableCount = 0;
+      return false;
+    }
+    if (nowMs - lastChangeMs < ALERT_DEBOUNCE_TIME) return false;
+
+    stableCount++;
+    if (stableCount >= 2 && nowMs - lastPublishMs >= ALERT_COOLDOWN && newCode != AlarmCode::None) {
+      lastPublishMs = nowMs;
+      return true;
+    }
+    return false;
+  }
+
+  void reset() { *this = AlertGate(); }
+
+ private:
+  AlarmCode code = AlarmCode::None;
+  uint32_t lastChangeMs = 0;
+  uint32_t lastPublishMs = 0;
+  uint32_t stableCount = 0;
+};
+
+// Hands the last LED word back every ALERT_REFRESH_MS while it decodes to an alarm in any
+// class. The classifier reports a steady or FLASHING pattern once, but the interlocks need
+// it again to stop a movement started after it, and a gate only publishes a code it sees
+// again after ALERT_DEBOUNCE_TIME.
+class AlarmRefresh {
+ public:
+  void seen(LEDStateWord newWord, const LEDAlarmResult& alarms, uint32_t nowMs) {
+    word = newWord;
+    active = alarms.red != AlarmCode::None || alarms.green != AlarmCode::None || alarms.amber != AlarmCode::None;
+    lastMs = nowMs;
+  }
+
+  bool due(uint32_t nowMs, LEDStateWord& out) {
+    if (!active || nowMs - lastMs < ALERT_REFRESH_MS) return false;
+    lastMs = nowMs;
+    out = word;
+    return true;
+  }
+
+ private:
+  LEDStateWord word = 0;
+  bool active = false;
+  uint32_t lastMs = 0;
+};
+
+// "red", "amber" or "green", as alerts are published
+inline const char* alarmClassName(AlarmClass alarmClass) {
+  switch (alarmClass) {
+    case AlarmClass::Red:   return "red";
+    case AlarmClass::Amber: return "amber";
+    case AlarmClass::Green: return "green";
+    default:                return "none";
+  }
+}
+
+// Interlocks and alert gates for the LED word: applied on every snapshot and again every
+// ALERT_REFRESH_MS while the word shows an alarm. Outputs is any type with
+// interlock(uint8_t flags), called first with the INTERLOCK_* flags to apply, and
+// alert(AlarmCode code), called for each class whose gate publishes.
+class LEDAlarmHandler {
+ public:
+  template <typename Outputs>
+  LEDAlarmResult apply(LEDStateWord word, uint32_t nowMs, Outputs& outputs) {
+    LEDAlarmResult alarms = decodeLEDAlarms(word);
+    if (alarms.interlock != INTERLOCK_NONE) outputs.interlock(alarms.interlock);
+    if (redGate.update(alarms.red, nowMs)) outputs.alert(alarms.red);
+    if (greenGate.update(alarms.green, nowMs)) outputs.alert(alarms.green);
+    if (amberGate.update(alarms.amber, nowMs)) outputs.alert(alarms.amber);
+    refresher.seen(word, alarms, nowMs);
+    return alarms;
+  }
+
+  // Applies the last word again when its refresh is due; false if it was not
+  template <typename Outputs>
+  bool refresh(uint32_t nowMs, Outputs& outputs) {
+    LEDStateWord word;
+    if (!refresher.due(nowMs, word)) return false;
+    apply(word, nowMs, outputs);
+    return true;
+  }
+
+  void reset() { *this = LEDAlarmHandler(); }
+
+ private:
+  AlertGate redGate;
+  AlertGate greenGate;
+  AlertGate amberGate;
+  AlarmRefresh refresher;
+};
+
+// ===== LED status text ===== //
+
+// What one snapshot looks like to people: a line per LED, served as the LED status, and a
+// summary for the serial log and LED history, e.g.
+// "LED States - [0,0,0,0] [1,1,1,1] - R00/G00/A02". Formatted in place, nothing allocated.
+struct LEDStatusText {
+  char lines[LED_STATUS_LINES_SIZE];
+  char summary[LED_STATUS_SUMMARY_SIZE];
+
+  void format(LEDStateWord word, const LEDAlarmResult& alarms) {
+    static const char* const states[] = {"OFF", "ON", "FLASHING"};
+    size_t len = 0;
+    for (int i = 0; i < 4; i++) {
+      len += snprintf(lines + len, sizeof(lines) - len, "Red LED %d: %s\nGreen LED %d: %s\n", i,
+                      states[ledDisplayState(word, false, i)], i, states[ledDisplayState(word, true, i)]);
+      if (len >= sizeof(lines)) break;
+    }
+
+    int n = snprintf(summary, sizeof(summary), "LED States - [%d,%d,%d,%d] [%d,%d,%d,%d]",
+                     ledDisplayState(word, false, 0), ledDisplayState(word, false, 1),
+                     ledDisplayState(word, false, 2), ledDisplayState(word, false, 3),
+                     ledDisplayState(word, true, 0), ledDisplayState(word, true, 1),
+                     ledDisplayState(word, true, 2), ledDisplayState(word, true, 3));
+    bool hasAlerts = false;
+    const AlarmCode codes[] = {alarms.red, alarms.green, alarms.amber};
+    for (AlarmCode code : codes) {
+      const AlarmInfo& info = alarmInfo(code);
+      if (info.alarmClass == AlarmClass::None || n >= (int)sizeof(summary)) continue;
+      n += snprintf(summary + n, sizeof(summary) - n, "%s%s", hasAlerts ? "/" : " - ", info.code);
+      hasAlerts = true;
+    }
+  }
+};
+
+// ===== Relay outputs ===== //
+
+// An up/down output pair. Reversing breaks before it makes: the running output opens and
+// the pair waits deadtimeUs before the other one closes. Relays is any type with
+// write(uint8_t pin, bool on), wait(uint32_t us) and nowUs(). wait() blocks the caller, so
+// one task drives a pair; upActive() and downActive() may be read from any task.
+template <typename Relays>
+class RelayPair {
+ public:
+  RelayPair(Relays& relays, uint8_t upPin, uint8_t downPin, uint32_t deadtimeUs)
+      : relays(relays), upPin(upPin), downPin(downPin), deadtimeUs(deadtimeUs) {}
+
+  // CMD_OP_UP, CMD_OP_DOWN, CMD_OP_STOP, CMD_OP_STOP_UP or CMD_OP_STOP_DOWN; false for any
+  // other opcode. gapUs is the measured break-before-make gap of a reversal, 0 otherwise.
+  bool execute(uint8_t opcode, uint32_t& gapUs) {
+    gapUs = 0;
+    switch (opcode) {
+      case CMD_OP_UP:
+        gapUs = make(upPin, up, downPin, down);
+        return true;
+      case CMD_OP_DOWN:
+        gapUs = make(downPin, down, upPin, up);
+        return true;
+      case CMD_OP_STOP:
+        open(upPin, up);
+        open(downPin, down);
+        return true;
+      case CMD_OP_STOP_UP:
+        open(upPin, up);
+        return true;
+      case CMD_OP_STOP_DOWN:
+        open(downPin, down);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // The stop opcode that opens the running outputs an interlock covers, 0 if none runs
+  uint8_t releaseOpcode(uint8_t interlock) const {
+    bool stopUp = (interlock & INTERLOCK_UP) && up;
+    bool stopDown = (interlock & INTERLOCK_DOWN) && down;
+    if (!stopUp && !stopDown) return 0;
+    return stopUp && stopDown ? CMD_OP_STOP : stopUp ? CMD_OP_STOP_UP : CMD_OP_STOP_DOWN;
+  }
+
+  // Opens the running outputs an interlock covers; returns the opcode run, 0 for none
+  uint8_t release(uint8_t interlock) {
+    uint8_t opcode = releaseOpcode(interlock);
+    uint32_t gapUs;
+    if (opcode) execute(opcode, gapUs);
+    return opcode;
+  }
+
+  bool upActive() const { return up; }
+  bool downActive() const { return down; }
+
+ private:
+  Relays& relays;
+  uint8_t upPin;
+  uint8_t downPin;
+  uint32_t deadtimeUs;
+  std::atomic<bool> up{false};
+  std::atomic<bool> down{false};
+
+  uint32_t make(uint8_t pin, std::atomic<bool>& on, uint8_t otherPin, std::atomic<bool>& other) {
+    bool reversing = other;
+    uint32_t offUs = 0;
+    if (reversing) {
+      relays.write(otherPin, false);
+      other = false;
+      offUs = relays.nowUs();
+      relays.wait(deadtimeUs);
+    }
+    relays.write(pin, true);
+    on = true;
+    return reversing ? relays.nowUs() - offUs : 0;
+  }
+
+  void open(uint8_t pin, std::atomic<bool>& on) {
+    relays.write(pin, false);
+    on = false;
+  }
+};
+
+// ===== Timing ===== //
+
+// Per-iteration loop time plus iterations per second over the last full second
+class LoopStats {
+ public:
+  void record(uint32_t elapsedUs, uint32_t nowMs) {
+    durations.record(elapsedUs);
+    windowIterations++;
+    if (nowMs - windowStartMs >= 1000) {
+      rate = (uint32_t)((uint64_t)windowIterations * 1000 / (nowMs - windowStartMs));
+      windowIterations = 0;
+      windowStartMs = nowMs;
+    }
+  }
+
+  uint32_t iterationsPerSecond() const { return rate; }
+  const LatencyHistogram& histogram() const { return durations; }
+  void resetHistogram() { durations.reset(); }
+
+ private:
+  LatencyHistogram durations;
+  uint32_t windowIterations = 0;
+  uint32_t windowStartMs = 0;
+  uint32_t rate = 0;
+};
+
+// Measured break-before-make gaps when a command reverses the lift
+struct InterlockStats {
+  uint32_t reversals;
+  uint32_t minGapUs;
+  uint32_t maxGapUs;
+
+  void record(uint32_t gapUs) {
+    if (reversals == 0 || gapUs < minGapUs) minGapUs = gapUs;
+    if (gapUs > maxGapUs) maxGapUs = gapUs;
+    reversals++;
+  }
+};
+
+#endif // CONTROLLER_LOGIC_H
@@ -0,0 +1,562 @@
+// EventStore.h - Append-only, segmented event log on flash with time-indexed range queries
+//
+// Events (log lines, LED status changes, alarms, commands) are appended as CRC-checked
+// records to fixed-size segment files. A full segment is sealed: its sparse time index
+// (one entry per EVENT_INDEX_STRIDE bytes) goes to a small sidecar file and a new segment
+// is started. Once EVENT_MAX_SEGMENTS exist, the oldest one is deleted. Its Alarm records
+// are first carried over into the alarm archive (segment 0, EVENT_ALARM_ARCHIVE_BYTES),
+// so a burst of LED or log records cannot push alarms out; the archive drops its own
+// oldest half when full. At boot, sealed segments are restored from their sidecars and
+// only the active segment and the archive are scanned; a torn record at the tail of the
+// active segment seals it at the last good record.
+//
+// Queries select a time range, a set of event types and optionally the records after a
+// known sequence number (for clients catching up), and stream the matching records
+// in chunks through a cursor, so a reader never holds more than one record in RAM.
+// Timestamps are Unix seconds and expected to be non-decreasing (NTP-synced clock); after
+// a clock step back, seeking inside one segment may skip a few of the older records.
+//
+// EventStore is not thread-safe: callers serialize access with their own lock. File
+// access is templated over the file system like MQTTOutbox (SPIFFS on the device, any
+// object with the same open/exists/remove API and directory listing on a host).
+
+#ifndef EVENT_STORE_H
+#define EVENT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CRC32.h"
+
+#ifndef EVENT_SEGMENT_BYTES
+#define EVENT_SEGMENT_BYTES 32768
+#endif
+#ifndef EVENT_MAX_SEGMENTS
+#define EVENT_MAX_SEGMENTS 16      // Flash budget: EVENT_MAX_SEGMENTS * EVENT_SEGMENT_BYTES
+#endif
+#define EVENT_INDEX_STRIDE 2048    // One sparse index entry per this many bytes
+#define EVENT_INDEX_ENTRIES (EVENT_SEGMENT_BYTES / EVENT_INDEX_STRIDE)
+#define EVENT_WRITE_BUFFER 1024    // Appends are staged here until flush()
+#define EVENT_PAYLOAD_MAX 240      // Longer payloads are cut short
+#define EVENT_SCAN_IDS 64          // Segment files considered at boot
+#ifndef EVENT_ALARM_ARCHIVE_BYTES
+#define EVENT_ALARM_ARCHIVE_BYTES EVENT_SEGMENT_BYTES  // Alarms kept beyond the segment budget
+#endif
+#define EVENT_ARCHIVE_ID 0         // Archive file name; segment ids start at 1
+
+enum class EventType : uint8_t {
+  Log = 1,        // addToLog() lines
+  LedStatus = 2,  // LED state snapshots
+  Alarm = 3,      // Red, amber and green alarms as published
+  Command = 4     // Executed lift commands
+};
+#define EVENT_TYPE_BIT(type) (1u << (uint8_t)(type))
+#define EVENT_TYPES_ALL 0xFFFFFFFFu
+
+inline const char* eventTypeName(uint8_t type) {
+  switch ((EventType)type) {
+    case EventType::Log:       return "log";
+    case EventType::LedStatus: return "led";
+    case EventType::Alarm:     return "alarm";
+    case EventType::Command:   return "command";
+    default:                   return "unknown";
+  }
+}
+
+// Type mask for a comma-separated list of type names, e.g. "alarm,command"
+inline uint32_t eventTypeMask(const char* names) {
+  if (!names || !*names) return EVENT_TYPES_ALL;
+  uint32_t mask = 0;
+  for (uint8_t type = 1; type <= (uint8_t)EventType::Command; type++) {
+    const char* name = eventTypeName(type);
+    size_t len = strlen(name);
+    for (const char* p = names; (p = strstr(p, name)) != nullptr; p += len) {
+      bool start = p == names || p[-1] == ',';
+      bool end = p[len] == '\0' || p[len] == ',';
+      if (start && end) mask |= EVENT_TYPE_BIT(type);
+    }
+  }
+  return mask;
+}
+
+struct EventRecordHeader {
+  uint8_t magic;
+  uint8_t type;
+  uint16_t length;
+  uint32_t timestamp;  // Unix seconds
+  uint32_t sequence;   // Store-wide, increments with every record
+  uint32_t crc;        // Over the header with crc = 0, then the payload
+};
+
+struct EventQuery {
+  uint32_t fromTime;
+  uint32_t toTime;
+  uint32_t typeMask;
+  uint32_t afterSequence;  // Only records newer than this sequence; 0 for all
+};
+
+// Position of a streaming query: start from EventCursor{} and call readChunk() until done
+struct EventCursor {
+  uint32_t segmentId;
+  uint32_t offset;
+  bool positioned;
+  bool done;
+};
+
+struct EventStoreStats {
+  uint32_t appends;
+  uint32_t dropped;         // Appends lost because the store could not be written
+  uint32_t flushes;
+  uint32_t rotations;
+  uint32_t corruptRecords;  // Torn or bad-CRC records found while loading or reading
+  uint32_t segments;
+  uint32_t bytes;           // Bytes on flash across all segments and the archive
+  uint32_t archivedAlarms;  // Alarm records in the archive
+};
+
+class EventStore {
+ public:
+  // Restore the segment list and indexes; must be called before anything is written
+  template <class FileSystem>
+  void load(FileSystem& fs) {
+    uint32_t ids[EVENT_SCAN_IDS];
+    int idCount = 0;
+    auto root = fs.open("/");
+    if (root) {
+      for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+        uint32_t id;
+        if (parseSegmentName(file.name(), id) && idCount < EVENT_SCAN_IDS) ids[idCount++] = id;
+        file.close();
+      }
+      root.close();
+    }
+    qsort(ids, idCount, sizeof(ids[0]), compareIds);
+
+    // Keep the newest segments; anything beyond the budget is left over from a crash
+    int first = idCount > EVENT_MAX_SEGMENTS ? idCount - EVENT_MAX_SEGMENTS : 0;
+    for (int i = 0; i < first; i++) removeFiles(fs, ids[i]);
+
+    segmentCount = 0;
+    stats = {};
+    nextSequence = 1;
+    if (!scanSegment(fs, EVENT_ARCHIVE_ID, archive)) {
+      stats.corruptRecords++;
+      compactArchive(fs, 0);  // Drop the torn tail so appends stay readable
+    }
+    stats.bytes = archive.bytes;
+    stats.archivedAlarms = archive.records;
+    nextSequence = archive.lastSequence + 1;
+    bool torn = false;
+    for (int i = first; i < idCount; i++) {
+      Segment& s = segments[segmentCount++];
+      bool active = i == idCount - 1;
+      if (active || !loadSidecar(fs, ids[i], s)) {
+        torn = !scanSegment(fs, ids[i], s);
+        if (torn) stats.corruptRecords++;
+      }
+      if (s.lastSequence >= nextSequence) nextSequence = s.lastSequence + 1;
+      stats.bytes += s.bytes;
+    }
+
+    if (segmentCount == 0) {
+      memset(&segments[0], 0, sizeof(Segment));
+      segments[0].id = 1;
+      segmentCount = 1;
+    }
+    loaded = true;
+    if (torn) rotate(fs);  // Never append behind a torn record
+    stats.segments = segmentCount;
+  }
+
+  // Stage one event; written on the next flush(), or now if the buffer is full
+  template <class FileSystem>
+  bool append(FileSystem& fs, EventType type, uint32_t timestamp, const char* payload, size_t length) {
+    if (length > EVENT_PAYLOAD_MAX) length = EVENT_PAYLOAD_MAX;
+    size_t recordBytes = sizeof(EventRecordHeader) + length;
+    if (pendingBytes + recordBytes > EVENT_WRITE_BUFFER && !flush(fs)) {
+      stats.dropped++;
+      return false;
+    }
+
+    EventRecordHeader header = {EVENT_MAGIC, (uint8_t)type, (uint16_t)length, timestamp, nextSequence++, 0};
+    header.crc = recordCRC(header, payload);
+    memcpy(pending + pendingBytes, &header, sizeof(header));
+    memcpy(pending + pendingBytes + sizeof(header), payload, length);
+    pendingBytes += recordBytes;
+    stats.appends++;
+    return true;
+  }
+
+  // Write staged events to the active segment, rotating as segments fill up
+  template <class FileSystem>
+  bool flush(FileSystem& fs) {
+    if (!loaded) return false;
+    if (pendingBytes == 0) return true;
+    if (rotatePending) rotate(fs);
+
+    size_t pos = 0;
+    while (pos < pendingBytes) {
+      Segment& active = segments[segmentCount - 1];
+      char path[EVENT_PATH_SIZE];
+      segmentPath(path, active.id, "log");
+      auto file = fs.open(path, "a");
+      if (!file) return false;
+
+      bool failed = false;
+      while (pos < pendingBytes) {
+        EventRecordHeader header;
+        memcpy(&header, pending + pos, sizeof(header));
+        size_t recordBytes = sizeof(header) + header.length;
+        if (active.bytes > 0 && active.bytes + recordBytes > EVENT_SEGMENT_BYTES) break;
+        if (file.write((const uint8_t*)pending + pos, recordBytes) != recordBytes) {
+          failed = true;
+          break;
+        }
+        noteRecord(active, active.bytes, header);
+        active.bytes += recordBytes;
+        stats.bytes += recordBytes;
+        pos += recordBytes;
+      }
+      file.close();
+
+      if (failed) {
+        // Keep what was not written and continue in a fresh segment next time
+        memmove(pending, pending + pos, pendingBytes - pos);
+        pendingBytes -= pos;
+        rotatePending = true;
+        return false;
+      }
+      if (pos < pendingBytes) rotate(fs);
+    }
+    pendingBytes = 0;
+    stats.flushes++;
+    return true;
+  }
+
+  // Stream up to maxRecords matching events to sink(header, payload) and advance the
+  // cursor. The payload is null-terminated. Returns the number of records delivered.
+  template <class FileSystem, class Sink>
+  uint16_t readChunk(FileSystem& fs, const EventQuery& query, EventCursor& cursor, uint16_t maxRecords,
+                     Sink&& sink) {
+    if (cursor.done) return 0;
+    flush(fs);
+
+    // Position 0 is the archive, older than every segment; then segments oldest first
+    uint16_t emitted = 0;
+    while (emitted < maxRecords) {
+      int s = 0;
+      while (s <= segmentCount && (segmentAt(s).id < cursor.segmentId || !overlaps(segmentAt(s), query))) s++;
+      if (s > segmentCount) {
+        cursor.done = true;
+        break;
+      }
+      const Segment& seg = segmentAt(s);
+      if (!cursor.positioned || seg.id != cursor.segmentId) {
+        cursor.segmentId = seg.id;
+        cursor.offset = seekOffset(seg, query.fromTime);
+        cursor.positioned = true;
+      }
+
+      if (cursor.offset < seg.bytes) {
+        char path[EVENT_PATH_SIZE];
+        segmentPath(path, seg.id, "log");
+        auto file = fs.open(path, "r");
+        if (!file || !file.seek(cursor.offset)) {
+          cursor.offset = seg.bytes;
+        }
+        while (file && cursor.offset < seg.bytes && emitted < maxRecords) {
+          EventRecordHeader header;
+          if (!readRecord(file, header)) {
+            stats.corruptRecords++;
+            cursor.offset = seg.bytes;  // Nothing after a bad record can be trusted
+            break;
+          }
+          cursor.offset += sizeof(header) + header.length;
+          if ((query.typeMask & EVENT_TYPE_BIT(header.type)) && header.timestamp >= query.fromTime &&
+              header.timestamp <= query.toTime && header.sequence > query.afterSequence) {
+            sink(header, (const char*)scratch);
+            emitted++;
+          }
+        }
+        if (file) file.close();
+      }
+
+      if (cursor.offset >= seg.bytes) {
+        if (s == segmentCount) {
+          cursor.done = true;
+          break;
+        }
+        cursor.segmentId = seg.id + 1;
+        cursor.positioned = false;
+      }
+    }
+    return emitted;
+  }
+
+  uint32_t oldestTime() const {
+    if (archive.records) return archive.minTime;
+    return segments[0].records ? segments[0].minTime : 0;
+  }
+  uint32_t lastSequence() const { return nextSequence - 1; }
+  const EventStoreStats& getStats() const { return stats; }
+
+ private:
+  static const uint8_t EVENT_MAGIC = 0xE5;
+  static const uint32_t SIDECAR_MAGIC = 0x45564958;  // "EVIX"
+  static const size_t EVENT_PATH_SIZE = 24;
+
+  struct IndexEntry {
+    uint32_t timestamp;
+    uint32_t offset;
+  };
+
+  struct Segment {
+    uint32_t id;
+    uint32_t bytes;         // Valid bytes in the segment file
+    uint32_t records;
+    uint32_t minTime;
+    uint32_t maxTime;
+    uint32_t lastSequence;
+    uint32_t indexCount;
+    IndexEntry index[EVENT_INDEX_ENTRIES];  // First record at or after each stride
+  };
+
+  struct Sidecar {
+    uint32_t magic;
+    Segment segment;
+    uint32_t crc;
+  };
+
+  Segment segments[EVENT_MAX_SEGMENTS];  // Oldest first; the last one is active
+  Segment archive = {};                  // Alarms carried over from deleted segments
+  int segmentCount = 0;
+  bool loaded = false;
+  bool rotatePending = false;
+  uint32_t nextSequence = 1;
+  uint8_t pending[EVENT_WRITE_BUFFER];
+  size_t pendingBytes = 0;
+  uint8_t scratch[EVENT_PAYLOAD_MAX + 1];  // Payload of the record being read
+  EventStoreStats stats = {};
+
+  const Segment& segmentAt(int position) const { return position == 0 ? archive : segments[position - 1]; }
+
+  static int compareIds(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+  }
+
+  static void segmentPath(char* path, uint32_t id, const char* extension) {
+    snprintf(path, EVENT_PATH_SIZE, "/ev_%08lx.%s", (unsigned long)id, extension);
+  }
+
+  // Accepts "/ev_0000002a.log" or "ev_0000002a.log" (directory listings differ by core)
+  static bool parseSegmentName(const char* name, uint32_t& id) {
+    if (!name) return false;
+    const char* base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (strlen(base) != 15 || strncmp(base, "ev_", 3) != 0 || strcmp(base + 11, ".log") != 0) return false;
+    char* end;
+    id = (uint32_t)strtoul(base + 3, &end, 16);
+    return end == base + 11 && id > 0;
+  }
+
+  static uint32_t recordCRC(EventRecordHeader header, const void* payload) {
+    header.crc = 0;
+    uint32_t crc = crc32Update(0, &header, sizeof(header));
+    return crc32Update(crc, payload, header.length);
+  }
+
+  static bool overlaps(const Segment& s, const EventQuery& query) {
+    return s.records > 0 && s.maxTime >= query.fromTime && s.minTime <= query.toTime &&
+           s.lastSequence > query.afterSequence;
+  }
+
+  // Offset of the last indexed record older than fromTime; everything before it is older too
+  static uint32_t seekOffset(const Segment& s, uint32_t fromTime) {
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < s.indexCount && s.index[i].timestamp < fromTime; i++) offset = s.index[i].offset;
+    return offset;
+  }
+
+  static void noteRecord(Segment& s, uint32_t offset, const EventRecordHeader& header) {
+    if (s.records == 0 || header.timestamp < s.minTime) s.minTime = header.timestamp;
+    if (s.records == 0 || header.timestamp > s.maxTime) s.maxTime = header.timestamp;
+    if (s.indexCount < EVENT_INDEX_ENTRIES && offset >= s.indexCount * EVENT_INDEX_STRIDE) {
+      s.index[s.indexCount++] = {header.timestamp, offset};
+    }
+    s.lastSequence = header.sequence;
+    s.records++;
+  }
+
+  // Reads and verifies the record at the file position; payload lands in scratch
+  template <class File>
+  bool readRecord(File& file, EventRecordHeader& header) {
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    if (header.magic != EVENT_MAGIC || header.length > EVENT_PAYLOAD_MAX) return false;
+    if (header.length > 0 && file.read(scratch, header.length) != header.length) return false;
+    scratch[header.length] = '\0';
+    return header.crc == recordCRC(header, scratch);
+  }
+
+  // Rebuilds a segment's index from its records. Returns false if it ends in a bad record.
+  template <class FileSystem>
+  bool scanSegment(FileSystem& fs, uint32_t id, Segment& s) {
+    memset(&s, 0, sizeof(s));
+    s.id = id;
+    char path[EVENT_PATH_SIZE];
+    segmentPath(path, id, "log");
+    auto file = fs.open(path, "r");
+    if (!file) return true;
+    size_t size = file.size();
+    EventRecordHeader header;
+    while (s.bytes < size && readRecord(file, header)) {
+      noteRecord(s, s.bytes, header);
+      s.bytes += sizeof(header) + header.length;
+    }
+    file.close();
+    return s.bytes == size;
+  }
+
+  template <class FileSystem>
+  bool loadSidecar(FileSystem& fs, uint32_t id, Segment& s) {
+    char path[EVENT_PATH_SIZE];
+    segmentPath(path, id, "idx");
+    if (!fs.exists(path)) return false;
+    auto file = fs.open(path, "r");
+    if (!file) return false;
+    Sidecar sidecar;
+    bool ok = file.read((uint8_t*)&sidecar, sizeof(sidecar)) == sizeof(sidecar);
+    file.close();
+    if (!ok || sidecar.magic != SIDECAR_MAGIC || sidecar.segment.id != id ||
+        sidecar.crc != crc32Update(0, &sidecar.segment, sizeof(sidecar.segment))) {
+      return false;
+    }
+    s = sidecar.segment;
+    return true;
+  }
+
+  template <class FileSystem>
+  void removeFiles(FileSystem& fs, uint32_t id) {
+    char path[EVENT_PATH_SIZE];
+    segmentPath(path, id, "log");
+    if (fs.exists(path)) fs.remove(path);
+    segmentPath(path, id, "idx");
+    if (fs.exists(path)) fs.remove(path);
+  }
+
+  // Appends the Alarm records of a segment about to be deleted to the archive
+  template <class FileSystem>
+  void archiveAlarms(FileSystem& fs, const Segment& s) {
+    char path[EVENT_PATH_SIZE];
+    segmentPath(path, s.id, "log");
+    auto file = fs.open(path, "r");
+    if (!file) return;
+    char archivePath[EVENT_PATH_SIZE];
+    segmentPath(archivePath, EVENT_ARCHIVE_ID, "log");
+    auto out = fs.open(archivePath, "a");
+
+    uint32_t offset = 0;
+    EventRecordHeader header;
+    while (out && offset < s.bytes) {
+      // Make room before reading: compaction reuses the scratch buffer
+      if (archive.bytes + sizeof(header) + EVENT_PAYLOAD_MAX > EVENT_ALARM_ARCHIVE_BYTES) {
+        out.close();
+        compactArchive(fs, EVENT_ALARM_ARCHIVE_BYTES / 2);
+        out = fs.open(archivePath, "a");
+        if (!out) break;
+      }
+      if (!readRecord(file, header)) break;
+      offset += sizeof(header) + header.length;
+      if (header.type != (uint8_t)EventType::Alarm) continue;
+
+      size_t recordBytes = sizeof(header) + header.length;
+      if (out.write((const uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+          out.write(scratch, header.length) != header.length) {
+        out.close();
+        compactArchive(fs, 0);  // Cut the partial record
+        break;
+      }
+      noteRecord(archive, archive.bytes, header);
+      archive.bytes += recordBytes;
+      stats.bytes += recordBytes;
+    }
+    if (out) out.close();
+    file.close();
+    stats.archivedAlarms = archive.records;
+  }
+
+  // Rewrites the archive keeping its newest records within keepBytes (0: every valid record)
+  template <class FileSystem>
+  void compactArchive(FileSystem& fs, uint32_t keepBytes) {
+    char path[EVENT_PATH_SIZE];
+    char tmpPath[EVENT_PATH_SIZE];
+    segmentPath(path, EVENT_ARCHIVE_ID, "log");
+    segmentPath(tmpPath, EVENT_ARCHIVE_ID, "tmp");
+    uint32_t skipBytes = keepBytes && archive.bytes > keepBytes ? archive.bytes - keepBytes : 0;
+
+    auto out = fs.open(tmpPath, "w");
+    if (!out) return;
+    Segment kept = {};
+    kept.id = EVENT_ARCHIVE_ID;
+    auto in = fs.open(path, "r");
+    if (in) {
+      uint32_t offset = 0;
+      EventRecordHeader header;
+      while (offset < archive.bytes && readRecord(in, header)) {
+        offset += sizeof(header) + header.length;
+        if (offset <= skipBytes) continue;
+        if (out.write((const uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+            out.write(scratch, header.length) != header.length) {
+          break;
+        }
+        noteRecord(kept, kept.bytes, header);
+        kept.bytes += sizeof(header) + header.length;
+      }
+      in.close();
+    }
+    out.close();
+    if (fs.exists(path)) fs.remove(path);
+    fs.rename(tmpPath, path);
+
+    stats.bytes = stats.bytes - archive.bytes + kept.bytes;
+    archive = kept;
+    stats.archivedAlarms = archive.records;
+  }
+
+  // Seal the active segment and start the next one, dropping the oldest beyond the budget
+  template <class FileSystem>
+  void rotate(FileSystem& fs) {
+    rotatePending = false;
+    Segment& active = segments[segmentCount - 1];
+    uint32_t nextId = active.id + 1;
+
+    Sidecar sidecar;
+    sidecar.magic = SIDECAR_MAGIC;
+    sidecar.segment = active;
+    sidecar.crc = crc32Update(0, &sidecar.segment, sizeof(sidecar.segment));
+    char path[EVENT_PATH_SIZE];
+    segmentPath(path, active.id, "idx");
+    auto file = fs.open(path, "w");
+    if (file) {
+      file.write((const uint8_t*)&sidecar, sizeof(sidecar));
+      file.close();
+    }
+
+    if (segmentCount == EVENT_MAX_SEGMENTS) {
+      archiveAlarms(fs, segments[0]);
+      removeFiles(fs, segments[0].id);
+      stats.bytes -= segments[0].bytes;
+      memmove(&segments[0], &segments[1], sizeof(Segment) * (segmentCount - 1));
+      segmentCount--;
+    }
+    Segment& next = segments[segmentCount++];
+    memset(&next, 0, sizeof(next));
+    next.id = nextId;
+    stats.rotations++;
+    stats.segments = segmentCount;
+  }
+};
+
+#endif // EVENT_STORE_H
@@ -0,0 +1,406 @@
+// FleetDispatch.h - Per-unit topics and an allocation-free message dispatcher for a lift fleet
+//
+// Every motor controller publishes under usf/unit/<unit>/..., with the part after "usf/" of its
+// single-lift topic as the suffix (usf/logs/alerts -> usf/unit/lift-1a2b3c/logs/alerts). One HMI
+// subscribes with usf/unit/+/... wildcards and hands each message to fleet_dispatch(), which
+// finds the unit in a fixed table by hash and the handler in a topic suffix table.
+//
+// Nothing here allocates or copies a payload: topics and JSON fields are sliced in place and
+// only a message that arrives in fragments is joined, in the preallocated reassembly buffer.
+//
+// Plain C so it can be included from the ESP-IDF HMI as well as the Arduino sketch. No locking:
+// callers that share a table between tasks guard it themselves.
+
+#ifndef FLEET_DISPATCH_H
+#define FLEET_DISPATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLEET_TOPIC_ROOT   "usf/"
+#define FLEET_UNIT_PREFIX  "usf/unit/"
+#define FLEET_UNIT_ID_MAX  23    // Longest unit id, without the terminator
+#define FLEET_TOPIC_MAX    64
+#define FLEET_MAX_UNITS    64
+#define FLEET_HASH_SLOTS   128   // Power of two, at least twice FLEET_MAX_UNITS
+#define FLEET_TEXT_MAX     48    // Last alert text kept per unit
+#define FLEET_MESSAGE_MAX  2048  // Largest message that can be reassembled from fragments
+#define FLEET_CODE_MAX     8     // Alarm code kept per class, e.g. "R02", with the terminator
+#define FLEET_LEVEL_HOLD_US 15000000LL  // A class counts as active this long after its newest alert
+
+// Alarm classes, in order of severity
+#define FLEET_LEVEL_NONE  0
+#define FLEET_LEVEL_GREEN 1
+#define FLEET_LEVEL_AMBER 2
+#define FLEET_LEVEL_RED   3
+#define FLEET_LEVEL_COUNT 3        // Classes tracked per unit, GREEN..RED
+
+typedef struct {
+    const char *ptr;
+    int len;
+} fleet_slice_t;
+
+// Newest alert of one class
+typedef struct {
+    char code[FLEET_CODE_MAX]; // Leading word of the alert text, e.g. "R02"
+    int64_t seen_us;           // Caller's clock at that alert, 0 never
+} fleet_class_t;
+
+typedef struct {
+    char id[FLEET_UNIT_ID_MAX + 1];
+    uint8_t id_len;
+    fleet_class_t classes[FLEET_LEVEL_COUNT];  // Indexed by FLEET_LEVEL_* - 1
+    int64_t last_seen_us;      // Caller's clock at the newest message
+    uint32_t messages;
+    uint32_t alerts;
+    uint32_t commands;
+    uint32_t loop_hz;          // From the newest loop metrics
+    uint32_t loop_max_us;
+    char last_alert[FLEET_TEXT_MAX];
+    uint8_t espnow_mac[6];     // From the unit's cmd/espnow topic (CommandFrame.h)
+    bool espnow_known;
+} fleet_unit_t;
+
+typedef struct {
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t unknown_topic;    // Not a unit topic, or no handler for the suffix
+    uint32_t table_full;       // Dropped: unit not known and FLEET_MAX_UNITS reached
+} fleet_stats_t;
+
+typedef struct {
+    fleet_unit_t units[FLEET_MAX_UNITS];  // In order of first message
+    uint8_t slots[FLEET_HASH_SLOTS];      // Unit index + 1, 0 when empty
+    uint8_t count;
+    fleet_stats_t stats;
+} fleet_table_t;
+
+typedef void (*fleet_handler_t)(fleet_unit_t *unit, const char *data, int len);
+
+typedef struct {
+    const char *suffix;        // Topic after usf/unit/<unit>/, e.g. "logs/alerts"
+    fleet_handler_t handler;
+} fleet_route_t;
+
+// ===== Topics ===== //
+
+// usf/<suffix> -> usf/unit/<unit>/<suffix>; false if topic is not under usf/ or dst is too small
+static inline bool fleet_unit_topic(char *dst, size_t size, const char *unit, const char *topic) {
+    size_t root = strlen(FLEET_TOPIC_ROOT);
+    if (strncmp(topic, FLEET_TOPIC_ROOT, root) != 0) return false;
+    int n = snprintf(dst, size, FLEET_UNIT_PREFIX "%s/%s", unit, topic + root);
+    return n > 0 && (size_t)n < size;
+}
+
+// Slices usf/unit/<unit>/<suffix> in place
+static inline bool fleet_topic_split(const char *topic, int len, fleet_slice_t *unit,
+                                     fleet_slice_t *suffix) {
+    int prefix = (int)strlen(FLEET_UNIT_PREFIX);
+    if (len <= prefix || memcmp(topic, FLEET_UNIT_PREFIX, prefix) != 0) return false;
+    const char *start = topic + prefix;
+    const char *slash = (const char *)memchr(start, '/', len - prefix);
+    if (!slash || slash == start || slash - start > FLEET_UNIT_ID_MAX) return false;
+    unit->ptr = start;
+    unit->len = (int)(slash - start);
+    suffix->ptr = slash + 1;
+    suffix->len = (int)(topic + len - suffix->ptr);
+    return suffix->len > 0;
+}
+
+// ===== Unit table ===== //
+
+static inline uint32_t fleet_hash(const char *s, int len) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Open addressing with linear probing; the table is at most half full, so a lookup touches
+// one or two slots. Adds the unit when create is set; NULL if absent or the table is full.
+static inline fleet_unit_t *fleet_find(fleet_table_t *table, const char *id, int len, bool create) {
+    if (len <= 0 || len > FLEET_UNIT_ID_MAX) return NULL;
+    uint32_t slot = fleet_hash(id, len) & (FLEET_HASH_SLOTS - 1);
+    for (;;) {
+        uint8_t index = table->slots[slot];
+        if (index == 0) break;
+        fleet_unit_t *unit = &table->units[index - 1];
+        if (unit->id_len == len && memcmp(unit->id, id, len) == 0) return unit;
+        slot = (slot + 1) & (FLEET_HASH_SLOTS - 1);
+    }
+    if (!create || table->count >= FLEET_MAX_UNITS) return NULL;
+
+    fleet_unit_t *unit = &table->units[table->count];
+    memset(unit, 0, sizeof(*unit));
+    memcpy(unit->id, id, len);
+    unit->id_len = (uint8_t)len;
+    table->slots[slot] = ++table->count;
+    return unit;
+}
+
+// Unit that announced this ESP-NOW MAC, NULL if none; a linear scan, for ESP-NOW acks only
+static inline fleet_unit_t *fleet_find_mac(fleet_table_t *table, const uint8_t *mac) {
+    for (uint8_t i = 0; i < table->count; i++) {
+        fleet_unit_t *unit = &table->units[i];
+        if (unit->espnow_known && memcmp(unit->espnow_mac, mac, sizeof(unit->espnow_mac)) == 0) return unit;
+    }
+    return NULL;
+}
+
+// ===== Alarm level ===== //
+
+// Records an alert of one class at the unit's last_seen_us (set by fleet_dispatch() before the
+// handler runs). The code is the alert text up to the first space.
+static inline void fleet_note_alert(fleet_unit_t *unit, uint8_t level, const char *text) {
+    if (level == FLEET_LEVEL_NONE || level > FLEET_LEVEL_COUNT) return;
+    fleet_class_t *cls = &unit->classes[level - 1];
+    size_t n = 0;
+    while (text[n] && text[n] != ' ' && n + 1 < sizeof(cls->code)) {
+        cls->code[n] = text[n];
+        n++;
+    }
+    cls->code[n] = '\0';
+    cls->seen_us = unit->last_seen_us ? unit->last_seen_us : 1;
+}
+
+// Most severe class with an alert in the last FLEET_LEVEL_HOLD_US, so a green report right
+// after a red one does not hide the red. FLEET_LEVEL_NONE when nothing is recent; *code is
+// set to the class's newest code, or "" for none.
+static inline uint8_t fleet_unit_level(const fleet_unit_t *unit, int64_t now_us, const char **code) {
+    for (uint8_t level = FLEET_LEVEL_COUNT; level > FLEET_LEVEL_NONE; level--) {
+        const fleet_class_t *cls = &unit->classes[level - 1];
+        if (cls->seen_us != 0 && now_us - cls->seen_us <= FLEET_LEVEL_HOLD_US) {
+            if (code) *code = cls->code;
+            return level;
+        }
+    }
+    if (code) *code = "";
+    return FLEET_LEVEL_NONE;
+}
+
+// ===== In-place JSON fields ===== //
+
+static inline int fleet_json_ws(const char *s, int i, int len) {
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) i++;
+    return i;
+}
+
+// Index just past the closing quote of the string starting at s[i] == '"', or -1
+static inline int fleet_json_string_end(const char *s, int i, int len) {
+    for (i++; i < len; i++) {
+        if (s[i] == '\\') i++;
+        else if (s[i] == '"') return i + 1;
+    }
+    return -1;
+}
+
+// Index just past the value starting at s[i], or -1
+static inline int fleet_json_value_end(const char *s, int i, int len) {
+    if (i >= len) return -1;
+    if (s[i] == '"') return fleet_json_string_end(s, i, len);
+    if (s[i] == '{' || s[i] == '[') {
+        int depth = 0;
+        while (i < len) {
+            char c = s[i];
+            if (c == '"') {
+                i = fleet_json_string_end(s, i, len);
+                if (i < 0) return -1;
+                continue;
+            }
+            if (c == '{' || c == '[') depth++;
+            else if ((c == '}' || c == ']') && --depth == 0) return i + 1;
+            i++;
+        }
+        return -1;
+    }
+    while (i < len && s[i] != ',' && s[i] != '}' && s[i] != ']' && s[i] != ' ' &&
+           s[i] != '\t' && s[i] != '\n' && s[i] != '\r') i++;
+    return i;
+}
+
+// One pass over the top level of a JSON object: values[k] is set to the value of keys[k] for
+// each key present (strings without their quotes and still escaped, other values as written)
+// and left {NULL, 0} otherwise. Returns how many keys were found, or -1 if the text is not an
+// object. Keys are matched as written, so a key containing escapes never matches.
+static inline int fleet_json_fields(const char *json, int len, const char *const keys[],
+                                    fleet_slice_t values[], int count) {
+    for (int k = 0; k < count; k++) {
+        values[k].ptr = NULL;
+        values[k].len = 0;
+    }
+    int i = fleet_json_ws(json, 0, len);
+    if (i >= len || json[i] != '{') return -1;
+    i = fleet_json_ws(json, i + 1, len);
+    if (i < len && json[i] == '}') return 0;
+
+    int found = 0;
+    while (i < len) {
+        if (json[i] != '"') return -1;
+        int key_end = fleet_json_string_end(json, i, len);
+        if (key_end < 0) return -1;
+        const char *key = json + i + 1;
+        int key_len = key_end - i - 2;
+
+        i = fleet_json_ws(json, key_end, len);
+        if (i >= len || json[i] != ':') return -1;
+        i = fleet_json_ws(json, i + 1, len);
+        int value_end = fleet_json_value_end(json, i, len);
+        if (value_end < 0 || value_end == i) return -1;
+
+        for (int k = 0; k < count; k++) {
+            if (values[k].ptr || (int)strlen(keys[k]) != key_len || memcmp(keys[k], key, key_len) != 0) continue;
+            bool quoted = json[i] == '"';
+            values[k].ptr = json + i + (quoted ? 1 : 0);
+            values[k].len = value_end - i - (quoted ? 2 : 0);
+            found++;
+            break;
+        }
+
+        i = fleet_json_ws(json, value_end, len);
+        if (i < len && json[i] == ',') {
+            i = fleet_json_ws(json, i + 1, len);
+        } else if (i < len && json[i] == '}') {
+            return found;
+        } else {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static inline bool fleet_slice_eq(fleet_slice_t slice, const char *s) {
+    return slice.ptr && (int)strlen(s) == slice.len && memcmp(slice.ptr, s, slice.len) == 0;
+}
+
+static inline uint32_t fleet_slice_uint(fleet_slice_t slice) {
+    uint32_t value = 0;
+    for (int i = 0; i < slice.len && slice.ptr[i] >= '0' && slice.ptr[i] <= '9'; i++) {
+        value = value * 10 + (uint32_t)(slice.ptr[i] - '0');
+    }
+    return value;
+}
+
+// Copies a JSON string value into dst, resolving the common escapes; \uXXXX becomes '?'.
+// Always terminates dst; returns the length copied.
+static inline int fleet_slice_copy(char *dst, size_t size, fleet_slice_t slice) {
+    size_t n = 0;
+    if (size == 0) return 0;
+    for (int i = 0; i < slice.len && n + 1 < size; i++) {
+        char c = slice.ptr[i];
+        if (c == '\\' && i + 1 < slice.len) {
+            c = slice.ptr[++i];
+            if (c == 'n') c = '\n';
+            else if (c == 't') c = '\t';
+            else if (c == 'r') c = '\r';
+            else if (c == 'b' || c == 'f') c = ' ';
+            else if (c == 'u') {
+                c = '?';
+                i += 4;
+            }
+        }
+        dst[n++] = c;
+    }
+    dst[n] = '\0';
+    return (int)n;
+}
+
+// ===== Fragment reassembly ===== //
+
+// A message larger than the client's receive buffer arrives as several data events that share
+// one total length; only the first carries the topic. Fragments of one message are never
+// interleaved with another message on a single connection.
+typedef struct {
+    char topic[FLEET_TOPIC_MAX];
+    int topic_len;
+    int total;                 // Length being reassembled; 0 idle, -1 skipping an oversized message
+    int received;
+    uint32_t joined;           // Messages completed from more than one fragment
+    uint32_t dropped;          // Oversized, truncated or out of order
+    char data[FLEET_MESSAGE_MAX];
+} fleet_reassembly_t;
+
+// Feeds one data event. Returns true when *topic and *data hold a complete message: the event
+// itself when it was not fragmented, otherwise the reassembly buffer once the last fragment
+// arrived. The buffer stays valid until the next event is fed.
+static inline bool fleet_reassemble(fleet_reassembly_t *r, const char **topic, int *topic_len,
+                                    const char **data, int *data_len, int offset, int total) {
+    if (offset == 0) {
+        if (r->total != 0) {
+            if (r->total > 0) r->dropped++;  // Previous message never completed
+            r->total = 0;
+        }
+        if (*data_len >= total) return true;
+
+        if (total > FLEET_MESSAGE_MAX || *topic_len <= 0 || *topic_len > FLEET_TOPIC_MAX) {
+            r->dropped++;
+            r->total = -1;
+            return false;
+        }
+        memcpy(r->topic, *topic, *topic_len);
+        r->topic_len = *topic_len;
+        memcpy(r->data, *data, *data_len);
+        r->received = *data_len;
+        r->total = total;
+        return false;
+    }
+
+    if (r->total <= 0) return false;
+    if (offset != r->received || total != r->total || r->received + *data_len > r->total) {
+        r->dropped++;
+        r->total = -1;
+        return false;
+    }
+    memcpy(r->data + r->received, *data, *data_len);
+    r->received += *data_len;
+    if (r->received < r->total) return false;
+
+    *topic = r->topic;
+    *topic_len = r->topic_len;
+    *data = r->data;
+    *data_len = r->total;
+    r->total = 0;
+    r->joined++;
+    return true;
+}
+
+// ===== Dispatch ===== //
+
+static inline fleet_handler_t fleet_route_find(const fleet_route_t *routes, int route_count,
+                                               fleet_slice_t suffix) {
+    for (int i = 0; i < route_count; i++) {
+        if (fleet_slice_eq(suffix, routes[i].suffix)) return routes[i].handler;
+    }
+    return NULL;
+}
+
+// Routes one complete message to its unit and handler. Returns the unit, or NULL if the message
+// was not for a known route or the unit could not be added.
+static inline fleet_unit_t *fleet_dispatch(fleet_table_t *table, const fleet_route_t *routes,
+                                           int route_count, const char *topic, int topic_len,
+                                           const char *data, int len, int64_t now_us) {
+    fleet_slice_t unit_id, suffix;
+    fleet_handler_t handler;
+    if (!fleet_topic_split(topic, topic_len, &unit_id, &suffix) ||
+        !(handler = fleet_route_find(routes, route_count, suffix))) {
+        table->stats.unknown_topic++;
+        return NULL;
+    }
+    fleet_unit_t *unit = fleet_find(table, unit_id.ptr, unit_id.len, true);
+    if (!unit) {
+        table->stats.table_full++;
+        return NULL;
+    }
+    table->stats.messages++;
+    table->stats.bytes += (uint32_t)len;
+    unit->messages++;
+    unit->last_seen_us = now_us;
+    handler(unit, data, len);
+    return unit;
+}
+
+#endif // FLEET_DISPATCH_H
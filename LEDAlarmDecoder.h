@@ -0,0 +1,273 @@
+// LEDAlarmDecoder.h - Table-driven decoder for the lift controller LED alarm patterns
+//
+// The controller reports its state on 4 red and 4 green LEDs, each of which can be
+// steady ON/OFF and/or FLASHING. This header turns a snapshot of those LEDs into the
+// red, green and amber alarm codes plus the movements that must be interlocked.
+//
+// All lookup tables are generated at compile time (constexpr) and decoding is a handful
+// of bit operations and three table reads, with no heap use. The header has no Arduino
+// dependencies so it can also be built on a Linux host.
+
+#ifndef LED_ALARM_DECODER_H
+#define LED_ALARM_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Packed LED state word layout:
+//   bits  0-3  red LED 0..3 ON
+//   bits  4-7  red LED 0..3 FLASHING
+//   bits  8-11 green LED 0..3 ON
+//   bits 12-15 green LED 0..3 FLASHING
+typedef uint16_t LEDStateWord;
+
+#define LED_RED_ON_SHIFT      0
+#define LED_RED_FLASH_SHIFT   4
+#define LED_GREEN_ON_SHIFT    8
+#define LED_GREEN_FLASH_SHIFT 12
+
+// Movement interlock flags
+#define INTERLOCK_NONE 0x00
+#define INTERLOCK_UP   0x01  // Opens the up outputs (RelayPair::release)
+#define INTERLOCK_DOWN 0x02  // Opens the down outputs
+
+enum class AlarmClass : uint8_t {
+  None,
+  Red,
+  Amber,
+  Green
+};
+
+enum class AlarmCode : uint8_t {
+  None,
+  // Red alarms
+  R00, R01, R02, R03, R05, R07, R10, R11, R12, R13, R15, R22, R23, R24, R27, R31, R36, R37,
+  // Green alarms
+  G00, G01, G02, G03, G04,
+  // Amber alarms
+  A01, A02, A04, A06, A08, A14, A16, A30, A32, A33, A34, A35, A36, A37, A38, A39, A40,
+  Count
+};
+
+struct AlarmInfo {
+  const char* code;         // Short code shown in the UI ("R02")
+  AlarmClass alarmClass;
+  const char* description;
+  uint8_t interlock;        // INTERLOCK_* flags applied when this code is matched
+};
+
+// Indexed by AlarmCode, must stay in the same order as the enum
+static constexpr AlarmInfo ALARM_INFO[] = {
+  {"",    AlarmClass::None,  "Unknown Alert Code",                    INTERLOCK_NONE},
+  {"R00", AlarmClass::Red,   "No FLASHING RED LEDs",                  INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R01", AlarmClass::Red,   "All RED LEDs are OFF",                  INTERLOCK_NONE},
+  {"R02", AlarmClass::Red,   "E-Stop is OFF",                         INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R03", AlarmClass::Red,   "Drive Nut Friction block fails",        INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R05", AlarmClass::Red,   "Motor temperature failure",             INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R07", AlarmClass::Red,   "Drive Train, Belt Failure",             INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R10", AlarmClass::Red,   "Final Limit",                           INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R11", AlarmClass::Red,   "Landing Switch (Top) failure",          INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R12", AlarmClass::Red,   "Landing Switch (Mid) failure",          INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R13", AlarmClass::Red,   "Landing Switch (Bottom) failure",       INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R15", AlarmClass::Red,   "OSG/Pit Switch activated",              INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R22", AlarmClass::Red,   "Door Open",                             INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R23", AlarmClass::Red,   "Door Lock Failure",                     INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R24", AlarmClass::Red,   "Drive Train Motor Failure",             INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R27", AlarmClass::Red,   "Drive Train Alignment",                 INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R31", AlarmClass::Red,   "Out of Service (flood switch)",         INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R36", AlarmClass::Red,   "Out of Service – periodic maintenance", INTERLOCK_UP | INTERLOCK_DOWN},
+  {"R37", AlarmClass::Red,   "Out of Service (travel time)",          INTERLOCK_UP | INTERLOCK_DOWN},
+  {"G00", AlarmClass::Green, "No exceptions",                         INTERLOCK_NONE},
+  {"G01", AlarmClass::Green, "All GREEN LEDs are OFF",                INTERLOCK_NONE},
+  {"G02", AlarmClass::Green, "No FLASHING GREEN LEDs",                INTERLOCK_NONE},
+  {"G03", AlarmClass::Green, "On Battery Power",                      INTERLOCK_NONE},
+  {"G04", AlarmClass::Green, "Bypass Jumpers/Service Switch",         INTERLOCK_NONE},
+  {"A01", AlarmClass::Amber, "ALL AMBER LEDs OFF",                    INTERLOCK_NONE},
+  {"A02", AlarmClass::Amber, "No FLASHING AMBER LEDs",                INTERLOCK_NONE},
+  {"A04", AlarmClass::Amber, "Power Failure",                         INTERLOCK_NONE},
+  {"A06", AlarmClass::Amber, "Motor Failure - UP Locked",             INTERLOCK_UP},
+  {"A08", AlarmClass::Amber, "Anti-Rock binding - UP Locked",         INTERLOCK_UP},
+  {"A14", AlarmClass::Amber, "Bottom Final Limit - DOWN Locked",      INTERLOCK_DOWN},
+  {"A16", AlarmClass::Amber, "Flood waters - DOWN Locked",            INTERLOCK_DOWN},
+  {"A30", AlarmClass::Amber, "Service Required (Flood switch)",       INTERLOCK_NONE},
+  {"A32", AlarmClass::Amber, "Power Failure - UP Locked",             INTERLOCK_UP},
+  {"A33", AlarmClass::Amber, "Service Required – travel time",        INTERLOCK_NONE},
+  {"A34", AlarmClass::Amber, "Service Required – maintenance",        INTERLOCK_NONE},
+  {"A35", AlarmClass::Amber, "Service Required – hours",              INTERLOCK_NONE},
+  {"A36", AlarmClass::Amber, "Service Required – Battery",            INTERLOCK_NONE},
+  {"A37", AlarmClass::Amber, "Service Required - Inverter",           INTERLOCK_NONE},
+  {"A38", AlarmClass::Amber, "Motor Temperature monitoring lost",     INTERLOCK_NONE},
+  {"A39", AlarmClass::Amber, "Power Failure",                         INTERLOCK_NONE},
+  {"A40", AlarmClass::Amber, "Power Failure",                         INTERLOCK_NONE},
+};
+
+static_assert(sizeof(ALARM_INFO) / sizeof(ALARM_INFO[0]) == (size_t)AlarmCode::Count,
+              "ALARM_INFO must have one entry per AlarmCode");
+
+inline const AlarmInfo& alarmInfo(AlarmCode code) {
+  return ALARM_INFO[(uint8_t)code < (uint8_t)AlarmCode::Count ? (uint8_t)code : 0];
+}
+
+// One decoded pattern row: the code plus the interlocks collected while matching it
+struct AlarmTableEntry {
+  AlarmCode code;
+  uint8_t interlock;
+};
+
+struct AlarmTable {
+  AlarmTableEntry entries[256];
+};
+
+// ===== Pattern rules (evaluated only at compile time) ===== //
+// Each rule takes a nibble of ON bits and a nibble of FLASHING bits (bit i = LED i) and
+// reproduces the original if/else chain from processLEDStatus().
+
+// Bit pattern helper: pattern(b0, b1, b2, b3) -> nibble
+constexpr uint8_t pattern(bool b0, bool b1, bool b2, bool b3) {
+  return (uint8_t)((b0 ? 1 : 0) | (b1 ? 2 : 0) | (b2 ? 4 : 0) | (b3 ? 8 : 0));
+}
+
+constexpr AlarmTableEntry redRule(uint8_t on, uint8_t flash) {
+  AlarmCode code = AlarmCode::None;
+  uint8_t interlock = INTERLOCK_NONE;
+
+  // Steady red patterns
+  if (on == pattern(0, 0, 0, 0)) code = AlarmCode::R01;
+  else if (on == pattern(1, 1, 1, 1)) code = AlarmCode::R02;
+  else if (on == pattern(1, 1, 1, 0)) code = AlarmCode::R15;
+  else if (on == pattern(1, 1, 0, 0)) code = AlarmCode::R23;
+  else if (on == pattern(0, 0, 1, 1)) code = AlarmCode::R22;
+  interlock |= ALARM_INFO[(uint8_t)code].interlock;
+
+  // Flashing red patterns override the steady ones
+  AlarmCode flashCode = AlarmCode::None;
+  if (flash == pattern(0, 0, 0, 0)) flashCode = AlarmCode::R00;
+  else if (flash == pattern(0, 1, 0, 0)) flashCode = AlarmCode::R31;
+  else if (flash == pattern(0, 1, 1, 1)) flashCode = AlarmCode::R36;
+  else if (flash == pattern(1, 0, 0, 0)) flashCode = AlarmCode::R37;
+  else if (flash == pattern(0, 1, 0, 1)) flashCode = AlarmCode::R07;
+  else if (flash == pattern(1, 1, 1, 1)) flashCode = AlarmCode::R03;
+  else if (flash == pattern(1, 0, 0, 1)) flashCode = AlarmCode::R27;
+  else if (flash == pattern(1, 1, 1, 0)) flashCode = AlarmCode::R10;
+  else if (flash == pattern(0, 0, 1, 0)) flashCode = AlarmCode::R11;
+  else if (flash == pattern(0, 1, 1, 0)) flashCode = AlarmCode::R12;
+  else if (flash == pattern(1, 0, 1, 0)) flashCode = AlarmCode::R13;
+  else if (flash == pattern(0, 0, 1, 1)) flashCode = AlarmCode::R24;
+  else if (flash == pattern(0, 0, 0, 1)) flashCode = AlarmCode::R05;
+  if (flashCode != AlarmCode::None) {
+    code = flashCode;
+    interlock |= ALARM_INFO[(uint8_t)flashCode].interlock;
+  }
+
+  return {code, interlock};
+}
+
+constexpr AlarmTableEntry greenRule(uint8_t on, uint8_t flash) {
+  AlarmCode code = AlarmCode::None;
+  if (on == pattern(0, 0, 0, 0)) code = AlarmCode::G01;
+  else if (on == pattern(1, 1, 1, 1)) code = AlarmCode::G00;
+  else if (flash == pattern(0, 0, 0, 0)) code = AlarmCode::G02;
+  else if (flash == pattern(1, 1, 1, 0)) code = AlarmCode::G03;
+  else if (flash == pattern(1, 1, 1, 1)) code = AlarmCode::G04;
+  return {code, INTERLOCK_NONE};
+}
+
+constexpr AlarmTableEntry amberRule(uint8_t on, uint8_t flash) {
+  AlarmCode code = AlarmCode::None;
+
+  // Steady amber patterns
+  if (on == pattern(0, 0, 0, 0)) code = AlarmCode::A01;
+  else if (on == pattern(1, 1, 1, 0)) code = AlarmCode::A04;
+  else if (on == pattern(0, 1, 1, 1)) code = AlarmCode::A39;
+  else if (on == pattern(1, 0, 0, 0)) code = AlarmCode::A30;
+  else if (on == pattern(0, 1, 0, 0)) code = AlarmCode::A33;
+  else if (on == pattern(1, 1, 0, 0)) code = AlarmCode::A34;
+  else if (on == pattern(0, 0, 1, 0)) code = AlarmCode::A35;
+  else if (on == pattern(0, 0, 1, 1)) code = AlarmCode::A36;
+  else if (on == pattern(1, 0, 0, 1)) code = AlarmCode::A37;
+
+  // Flashing amber patterns override the steady ones
+  AlarmCode flashCode = AlarmCode::None;
+  if (flash == pattern(0, 0, 0, 0)) flashCode = AlarmCode::A02;
+  else if (flash == pattern(1, 1, 1, 0)) flashCode = AlarmCode::A32;
+  else if (flash == pattern(0, 1, 1, 1)) flashCode = AlarmCode::A40;
+  else if (flash == pattern(0, 0, 1, 0)) flashCode = AlarmCode::A06;
+  else if (flash == pattern(1, 0, 0, 1)) flashCode = AlarmCode::A08;
+  else if (flash == pattern(1, 1, 0, 0)) flashCode = AlarmCode::A14;
+  else if (flash == pattern(0, 1, 0, 0)) flashCode = AlarmCode::A16;
+  else if (flash == pattern(0, 1, 1, 0)) flashCode = AlarmCode::A38;
+  if (flashCode != AlarmCode::None) code = flashCode;
+
+  return {code, ALARM_INFO[(uint8_t)flashCode].interlock};
+}
+
+// Builds a 256-entry table indexed by (flash << 4) | on
+template <AlarmTableEntry (*Rule)(uint8_t, uint8_t)>
+constexpr AlarmTable buildAlarmTable() {
+  AlarmTable table = {};
+  for (int i = 0; i < 256; i++) {
+    table.entries[i] = Rule((uint8_t)(i & 0x0F), (uint8_t)(i >> 4));
+  }
+  return table;
+}
+
+static constexpr AlarmTable RED_ALARM_TABLE = buildAlarmTable<redRule>();
+static constexpr AlarmTable GREEN_ALARM_TABLE = buildAlarmTable<greenRule>();
+static constexpr AlarmTable AMBER_ALARM_TABLE = buildAlarmTable<amberRule>();
+
+// ===== Decoder ===== //
+
+struct LEDAlarmResult {
+  AlarmCode red;
+  AlarmCode green;
+  AlarmCode amber;
+  uint8_t interlock;  // INTERLOCK_* flags to apply
+};
+
+constexpr LEDStateWord packLEDState(uint8_t redOn, uint8_t redFlash, uint8_t greenOn, uint8_t greenFlash) {
+  return (LEDStateWord)(((redOn & 0x0F) << LED_RED_ON_SHIFT) |
+                        ((redFlash & 0x0F) << LED_RED_FLASH_SHIFT) |
+                        ((greenOn & 0x0F) << LED_GREEN_ON_SHIFT) |
+                        ((greenFlash & 0x0F) << LED_GREEN_FLASH_SHIFT));
+}
+
+// Display state of one LED as used in the status message: 0 = OFF, 1 = ON, 2 = FLASHING
+constexpr int ledDisplayState(LEDStateWord word, bool green, int index) {
+  return ((word >> ((green ? LED_GREEN_FLASH_SHIFT : LED_RED_FLASH_SHIFT) + index)) & 1) ? 2 :
+         ((word >> ((green ? LED_GREEN_ON_SHIFT : LED_RED_ON_SHIFT) + index)) & 1) ? 1 : 0;
+}
+
+constexpr LEDAlarmResult decodeLEDAlarms(LEDStateWord word) {
+  uint8_t r = (word >> LED_RED_ON_SHIFT) & 0x0F;
+  uint8_t rf = (word >> LED_RED_FLASH_SHIFT) & 0x0F;
+  uint8_t g = (word >> LED_GREEN_ON_SHIFT) & 0x0F;
+  uint8_t gf = (word >> LED_GREEN_FLASH_SHIFT) & 0x0F;
+
+  // Amber is a red/green pair per LED index: steady when both are ON,
+  // flashing when at least one flashes and the other is ON or flashing
+  uint8_t a = r & g;
+  uint8_t af = (rf & gf) | (rf & g) | (r & gf);
+
+  LEDAlarmResult result = {AlarmCode::None, AlarmCode::None, AlarmCode::None, INTERLOCK_NONE};
+
+  // Red alarms only when no green LED is ON and no amber is flashing
+  if (g == 0 && af == 0) {
+    const AlarmTableEntry& red = RED_ALARM_TABLE.entries[(rf << 4) | r];
+    result.red = red.code;
+    result.interlock |= red.interlock;
+  }
+
+  // Green alarms only when no red LED is flashing
+  if (rf == 0) {
+    result.green = GREEN_ALARM_TABLE.entries[(gf << 4) | g].code;
+  }
+
+  // Amber alarms have no mutual exclusion
+  const AlarmTableEntry& amber = AMBER_ALARM_TABLE.entries[(af << 4) | a];
+  result.amber = amber.code;
+  result.interlock |= amber.interlock;
+
+  return result;
+}
+
+#endif // LED_ALARM_DECODER_H
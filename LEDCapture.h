@@ -0,0 +1,283 @@
+// LEDCapture.h - Interrupt-driven LED edge capture and flash classification
+//
+// GPIO edge interrupts push timestamped edges into a lock-free single-producer /
+// single-consumer ring. A consumer task drains the ring, keeps a short edge history per
+// LED and classifies each LED as OFF, ON or FLASHING (with its measured frequency) over a
+// sliding window. Classifications that stay stable for the debounce time are published
+// as LEDSnapshots for the alarm logic.
+//
+// No Arduino dependencies: timestamps are passed in by the caller (micros() on the
+// device), so the ring and classifier can be driven by synthetic edge traces on a host.
+
+#ifndef LED_CAPTURE_H
+#define LED_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "LEDAlarmDecoder.h"
+
+// ===== Capture Configuration ===== //
+#ifndef LED_FLASH_WINDOW_US
+#define LED_FLASH_WINDOW_US 1500000UL  // Sliding window used to detect flashing
+#endif
+#ifndef LED_FLASH_MIN_EDGES
+#define LED_FLASH_MIN_EDGES 3          // Edges within the window to call an LED FLASHING
+#endif
+#ifndef LED_GLITCH_US
+#define LED_GLITCH_US 2000UL           // Pulses shorter than this are treated as noise
+#endif
+#ifndef LED_STABLE_US
+#define LED_STABLE_US 30000UL          // Classification must hold this long to be published
+#endif
+
+#define LED_CAPTURE_COUNT 8            // LEDs 0-3 red, 4-7 green
+#define LED_EDGE_HISTORY 8             // Edge timestamps kept per LED (power of two)
+
+#define LED_CAPTURE_INLINE inline __attribute__((always_inline))
+
+// ===== Lock-free SPSC ring ===== //
+// One producer (ISR or task) calls push(), one consumer calls pop(). Capacity must be a
+// power of two. push() never blocks and counts dropped items when the ring is full.
+template <class T, uint32_t Capacity>
+class SPSCRing {
+  static_assert((Capacity & (Capacity - 1)) == 0, "SPSCRing capacity must be a power of two");
+
+ public:
+  LED_CAPTURE_INLINE bool push(const T& item) {
+    uint32_t head = headIndex.load(std::memory_order_relaxed);
+    if (head - tailIndex.load(std::memory_order_acquire) >= Capacity) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items[head & (Capacity - 1)] = item;
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  LED_CAPTURE_INLINE bool pop(T& item) {
+    uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail == headIndex.load(std::memory_order_acquire)) return false;
+    item = items[tail & (Capacity - 1)];
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return headIndex.load(std::memory_order_acquire) - tailIndex.load(std::memory_order_acquire);
+  }
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+ private:
+  T items[Capacity];
+  std::atomic<uint32_t> headIndex{0};
+  std::atomic<uint32_t> tailIndex{0};
+  std::atomic<uint32_t> droppedCount{0};
+};
+
+// ===== Edges and snapshots ===== //
+
+struct LEDEdge {
+  uint32_t timestampUs;
+  uint8_t led;    // 0-3 red, 4-7 green
+  uint8_t level;  // Level after the edge
+};
+
+enum class LEDClass : uint8_t {
+  Off,
+  On,
+  Flashing
+};
+
+struct LEDSnapshot {
+  LEDStateWord word;                         // Packed ON/FLASHING bits, see LEDAlarmDecoder.h
+  uint16_t frequencyCentiHz[LED_CAPTURE_COUNT];  // Measured flash frequency, 0 when steady
+  uint32_t sequence;                         // Increments with every published snapshot
+  uint32_t timestampUs;                      // When the snapshot was published
+  uint32_t detectionLatencyUs;               // First edge of the change -> publish
+};
+
+struct LEDCaptureStats {
+  uint32_t edges;                  // Edges consumed from the ring
+  uint32_t glitches;               // Pulses shorter than LED_GLITCH_US that were cancelled
+  uint32_t snapshots;              // Snapshots published
+  uint32_t lastDetectionLatencyUs; // Any change: first edge -> publish
+  uint32_t maxDetectionLatencyUs;
+  uint32_t lastFlashLatencyUs;     // First edge of a flash pattern -> FLASHING published
+  uint32_t maxFlashLatencyUs;
+};
+
+// ===== Classifier ===== //
+
+class LEDClassifier {
+ public:
+  // Seed the steady level of each LED, e.g. from digitalRead() at startup
+  void begin(const bool levels[LED_CAPTURE_COUNT], uint32_t nowUs) {
+    for (uint8_t i = 0; i < LED_CAPTURE_COUNT; i++) {
+      LEDTrack& t = tracks[i];
+      t.level = levels[i];
+      t.head = 0;
+      t.count = 0;
+      t.changePending = false;
+    }
+    publishedWord = classify(nowUs, nullptr);
+    pendingWord = publishedWord;
+    pendingSinceUs = nowUs;
+    sequence = 0;
+    stats = {};
+  }
+
+  // Feed one edge from the capture ring
+  void addEdge(const LEDEdge& edge) {
+    if (edge.led >= LED_CAPTURE_COUNT) return;
+    LEDTrack& t = tracks[edge.led];
+    stats.edges++;
+    t.level = edge.level != 0;
+
+    // A second edge right after the first is a glitch: cancel the pulse
+    if (t.count > 0 && edge.timestampUs - newest(t) < LED_GLITCH_US) {
+      t.head = (t.head - 1) & (LED_EDGE_HISTORY - 1);
+      t.count--;
+      stats.glitches++;
+      return;
+    }
+
+    if (!t.changePending) {
+      t.changePending = true;
+      t.changeStartUs = edge.timestampUs;
+    }
+    t.edgeUs[t.head] = edge.timestampUs;
+    t.head = (t.head + 1) & (LED_EDGE_HISTORY - 1);
+    if (t.count < LED_EDGE_HISTORY) t.count++;
+  }
+
+  // Re-classify at nowUs. Returns true and fills snapshot when a new debounced state is
+  // ready for the alarm logic.
+  bool update(uint32_t nowUs, LEDSnapshot& snapshot) {
+    uint16_t frequency[LED_CAPTURE_COUNT];
+    LEDStateWord word = classify(nowUs, frequency);
+
+    if (word != pendingWord) {
+      pendingWord = word;
+      pendingSinceUs = nowUs;
+    }
+
+    if (pendingWord == publishedWord) {
+      // Nothing new; forget edges that did not change the classification
+      for (uint8_t i = 0; i < LED_CAPTURE_COUNT; i++) {
+        if (tracks[i].count == 0) tracks[i].changePending = false;
+      }
+      return false;
+    }
+    if (nowUs - pendingSinceUs < LED_STABLE_US) return false;
+
+    // Publish; latency is measured from the first unpublished edge of each changed LED, or
+    // from the first edge in the window for LEDs that just became FLASHING
+    LEDStateWord changed = publishedWord ^ pendingWord;
+    LEDStateWord flashStarted = pendingWord & ~publishedWord & flashBits();
+    uint32_t latencyUs = 0;
+    for (uint8_t i = 0; i < LED_CAPTURE_COUNT; i++) {
+      LEDTrack& t = tracks[i];
+      if (!(changed & ledMask(i))) continue;
+      uint32_t ledLatency = 0;
+      if (flashStarted & ledMask(i)) {
+        ledLatency = nowUs - oldest(t);
+        stats.lastFlashLatencyUs = ledLatency;
+        if (ledLatency > stats.maxFlashLatencyUs) stats.maxFlashLatencyUs = ledLatency;
+      } else if (t.changePending) {
+        ledLatency = nowUs - t.changeStartUs;
+      }
+      if (ledLatency > latencyUs) latencyUs = ledLatency;
+      t.changePending = false;
+    }
+
+    publishedWord = pendingWord;
+    snapshot.word = publishedWord;
+    for (uint8_t i = 0; i < LED_CAPTURE_COUNT; i++) snapshot.frequencyCentiHz[i] = frequency[i];
+    snapshot.sequence = ++sequence;
+    snapshot.timestampUs = nowUs;
+    snapshot.detectionLatencyUs = latencyUs;
+
+    stats.snapshots++;
+    stats.lastDetectionLatencyUs = latencyUs;
+    if (latencyUs > stats.maxDetectionLatencyUs) stats.maxDetectionLatencyUs = latencyUs;
+    return true;
+  }
+
+  LEDClass classOf(uint8_t led) const {
+    if (led >= LED_CAPTURE_COUNT) return LEDClass::Off;
+    LEDStateWord mask = ledMask(led);
+    if (publishedWord & mask & flashBits()) return LEDClass::Flashing;
+    return (publishedWord & mask) ? LEDClass::On : LEDClass::Off;
+  }
+
+  LEDStateWord currentWord() const { return publishedWord; }
+  const LEDCaptureStats& getStats() const { return stats; }
+
+ private:
+  struct LEDTrack {
+    uint32_t edgeUs[LED_EDGE_HISTORY];  // Ring of recent edge timestamps
+    uint8_t head;
+    uint8_t count;
+    bool level;
+    bool changePending;                 // An edge arrived that is not yet published
+    uint32_t changeStartUs;             // First unpublished edge
+  };
+
+  LEDTrack tracks[LED_CAPTURE_COUNT] = {};
+  LEDStateWord publishedWord = 0;
+  LEDStateWord pendingWord = 0;
+  uint32_t pendingSinceUs = 0;
+  uint32_t sequence = 0;
+  LEDCaptureStats stats = {};
+
+  static uint32_t newest(const LEDTrack& t) {
+    return t.edgeUs[(t.head - 1) & (LED_EDGE_HISTORY - 1)];
+  }
+
+  static uint32_t oldest(const LEDTrack& t) {
+    return t.edgeUs[(t.head - t.count) & (LED_EDGE_HISTORY - 1)];
+  }
+
+  // ON and FLASHING bits that belong to one LED in the packed word
+  static LEDStateWord ledMask(uint8_t led) {
+    return led < 4 ? (LEDStateWord)((1u << (LED_RED_ON_SHIFT + led)) | (1u << (LED_RED_FLASH_SHIFT + led)))
+                   : (LEDStateWord)((1u << (LED_GREEN_ON_SHIFT + led - 4)) | (1u << (LED_GREEN_FLASH_SHIFT + led - 4)));
+  }
+
+  static LEDStateWord flashBits() {
+    return (LEDStateWord)((0x0F << LED_RED_FLASH_SHIFT) | (0x0F << LED_GREEN_FLASH_SHIFT));
+  }
+
+  // Drops edges that left the window and builds the packed word for nowUs
+  LEDStateWord classify(uint32_t nowUs, uint16_t* frequency) {
+    uint8_t redOn = 0, redFlash = 0, greenOn = 0, greenFlash = 0;
+    for (uint8_t i = 0; i < LED_CAPTURE_COUNT; i++) {
+      LEDTrack& t = tracks[i];
+      while (t.count > 0 && nowUs - oldest(t) > LED_FLASH_WINDOW_US) t.count--;
+
+      bool flashing = t.count >= LED_FLASH_MIN_EDGES;
+      uint16_t centiHz = 0;
+      if (flashing) {
+        // (count - 1) edges are (count - 1) / 2 periods
+        uint32_t spanUs = newest(t) - oldest(t);
+        if (spanUs > 0) centiHz = (uint16_t)(((uint64_t)(t.count - 1) * 50000000ULL) / spanUs);
+      }
+      if (frequency) frequency[i] = centiHz;
+
+      // A FLASHING LED reports no ON bit, otherwise every toggle would change the word
+      bool on = t.level && !flashing;
+      uint8_t bit = 1 << (i & 3);
+      if (i < 4) {
+        if (on) redOn |= bit;
+        if (flashing) redFlash |= bit;
+      } else {
+        if (on) greenOn |= bit;
+        if (flashing) greenFlash |= bit;
+      }
+    }
+    return packLEDState(redOn, redFlash, greenOn, greenFlash);
+  }
+};
+
+#endif // LED_CAPTURE_H
@@ -0,0 +1,93 @@
+// LogRing.h - Fixed-capacity ring of text lines with a line index
+//
+// Line text is stored back to back in one byte buffer; a separate index holds the offset,
+// length and kind of each retained line. Appending never allocates: when either the index
+// or the text buffer is full, the oldest lines are dropped. Lines are addressed by an
+// absolute line number that keeps counting up, so a viewer can tell which rows changed.
+//
+// Plain C with no LVGL dependency, so it can be exercised on a host.
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_RING_LINES 256          // Lines kept per ring (index capacity)
+#define LOG_RING_TEXT_BYTES 16384   // Text storage per ring
+#define LOG_LINE_MAX 160            // Longer lines are cut short
+
+// Line kinds, used by the view for colouring
+#define LOG_KIND_INFO    0
+#define LOG_KIND_COMMAND 1
+#define LOG_KIND_RED     2
+#define LOG_KIND_AMBER   3
+#define LOG_KIND_GREEN   4
+#define LOG_KIND_COUNT   5
+
+typedef struct {
+    char text[LOG_RING_TEXT_BYTES];        // Null-terminated lines, never split across the end
+    uint16_t line_offset[LOG_RING_LINES];  // Index, by absolute line number % LOG_RING_LINES
+    uint8_t line_len[LOG_RING_LINES];
+    uint8_t line_kind[LOG_RING_LINES];
+    uint32_t first_line;                   // Absolute number of the oldest retained line
+    uint32_t next_line;                    // Absolute number the next line will get
+    uint16_t write_pos;                    // Where the next line's text goes
+    uint32_t dropped;                      // Lines pushed out to make room
+} log_ring_t;
+
+static inline void log_ring_init(log_ring_t *ring) {
+    memset(ring, 0, sizeof(*ring));
+}
+
+static inline uint32_t log_ring_count(const log_ring_t *ring) {
+    return ring->next_line - ring->first_line;
+}
+
+static inline void log_ring_drop_oldest(log_ring_t *ring) {
+    ring->first_line++;
+    ring->dropped++;
+}
+
+// Appends one line of at most LOG_LINE_MAX - 1 bytes (trailing newlines are stripped)
+static inline void log_ring_append(log_ring_t *ring, const char *line, size_t len, uint8_t kind) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    if (len > LOG_LINE_MAX - 1) len = LOG_LINE_MAX - 1;
+
+    if (log_ring_count(ring) == LOG_RING_LINES) log_ring_drop_oldest(ring);
+
+    // Text is laid out in age order starting at write_pos; wrapping to 0 retires everything
+    // stored after write_pos first, then whatever the new line overlaps
+    uint32_t place = ring->write_pos;
+    bool wrapped = place + len + 1 > LOG_RING_TEXT_BYTES;
+    if (wrapped) place = 0;
+    while (log_ring_count(ring) > 0) {
+        uint32_t slot = ring->first_line % LOG_RING_LINES;
+        uint32_t start = ring->line_offset[slot];
+        uint32_t end = start + ring->line_len[slot] + 1;
+        bool retired = wrapped && start >= ring->write_pos;
+        bool overlaps = start < place + len + 1 && place < end;
+        if (!retired && !overlaps) break;
+        log_ring_drop_oldest(ring);
+    }
+
+    uint32_t slot = ring->next_line % LOG_RING_LINES;
+    memcpy(ring->text + place, line, len);
+    ring->text[place + len] = '\0';
+    ring->line_offset[slot] = (uint16_t)place;
+    ring->line_len[slot] = (uint8_t)len;
+    ring->line_kind[slot] = kind;
+    ring->write_pos = (uint16_t)(place + len + 1);
+    ring->next_line++;
+}
+
+// Text of an absolute line number, or NULL if it is no longer (or not yet) retained
+static inline const char *log_ring_line(const log_ring_t *ring, uint32_t line, uint8_t *kind) {
+    if (line - ring->first_line >= log_ring_count(ring)) return NULL;
+    uint32_t slot = line % LOG_RING_LINES;
+    if (kind) *kind = ring->line_kind[slot];
+    return ring->text + ring->line_offset[slot];
+}
+
+#endif // LOG_RING_H
@@ -0,0 +1,126 @@
+// LogView.h - Virtualized LVGL log view backed by a LogRing
+//
+// Only the rows that fit in the view (plus one spare) exist as label objects. A spacer
+// child gives the container the scroll height of every retained line, and on each scroll
+// or refresh the rows are repositioned over the visible lines. Line L is always drawn by
+// row L % row_count, so a one-line scroll or append re-texts a single row and leaves the
+// others untouched. While scrolled to the bottom the view follows new lines.
+//
+// All functions must run on the LVGL thread. Appends are batched: log_view_append() only
+// marks the view dirty and log_view_flush() updates it once per frame.
+
+#ifndef LOG_VIEW_H
+#define LOG_VIEW_H
+
+#include "lvgl.h"
+#include "LogRing.h"
+
+#define LOG_VIEW_MAX_ROWS 48
+#define LOG_VIEW_NO_LINE UINT32_MAX
+
+typedef struct {
+    lv_obj_t *container;
+    lv_obj_t *spacer;                          // Sets the scrollable content height
+    lv_obj_t *rows[LOG_VIEW_MAX_ROWS];
+    uint32_t row_line[LOG_VIEW_MAX_ROWS];      // Absolute line shown by each row
+    uint8_t row_count;
+    lv_coord_t row_height;
+    bool follow;                               // Scrolled to the bottom: keep showing the newest line
+    bool dirty;                                // Lines appended since the last flush
+    lv_color_t kind_color[LOG_KIND_COUNT];
+    log_ring_t ring;
+} log_view_t;
+
+// Positions the rows over the lines that are currently scrolled into view
+static void log_view_sync_rows(log_view_t *view) {
+    uint32_t count = log_ring_count(&view->ring);
+    lv_coord_t top = lv_obj_get_scroll_top(view->container);
+    uint32_t first_visible = top > 0 ? (uint32_t)(top / view->row_height) : 0;
+
+    for (uint8_t i = 0; i < view->row_count; i++) {
+        uint32_t index = first_visible + i;
+        uint32_t line = view->ring.first_line + index;
+        uint8_t r = line % view->row_count;
+        lv_obj_t *row = view->rows[r];
+
+        if (index >= count) {
+            if (view->row_line[r] != LOG_VIEW_NO_LINE) {
+                lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+                view->row_line[r] = LOG_VIEW_NO_LINE;
+            }
+            continue;
+        }
+        if (view->row_line[r] != line) {
+            uint8_t kind = LOG_KIND_INFO;
+            const char *text = log_ring_line(&view->ring, line, &kind);
+            lv_label_set_text(row, text ? text : "");
+            lv_obj_set_style_text_color(row, view->kind_color[kind < LOG_KIND_COUNT ? kind : 0], LV_PART_MAIN);
+            if (view->row_line[r] == LOG_VIEW_NO_LINE) lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+            view->row_line[r] = line;
+        }
+        lv_obj_set_y(row, (lv_coord_t)(index * view->row_height));  // No-op when unchanged
+    }
+}
+
+static void log_view_scroll_cb(lv_event_t *e) {
+    log_view_t *view = (log_view_t *)lv_event_get_user_data(e);
+    view->follow = lv_obj_get_scroll_bottom(view->container) <= view->row_height;
+    log_view_sync_rows(view);
+}
+
+static void log_view_create(log_view_t *view, lv_obj_t *parent, lv_coord_t width, lv_coord_t height,
+                            lv_color_t text_color) {
+    memset(view, 0, sizeof(*view));
+    log_ring_init(&view->ring);
+    view->follow = true;
+    for (int k = 0; k < LOG_KIND_COUNT; k++) view->kind_color[k] = text_color;
+    view->kind_color[LOG_KIND_RED] = lv_color_hex(0xFF0000);
+    view->kind_color[LOG_KIND_AMBER] = lv_color_hex(0xFFBF00);
+    view->kind_color[LOG_KIND_GREEN] = lv_color_hex(0x00FF00);
+
+    view->container = lv_obj_create(parent);
+    lv_obj_set_size(view->container, width, height);
+    lv_obj_set_scroll_dir(view->container, LV_DIR_VER);
+    lv_obj_set_style_text_color(view->container, text_color, LV_PART_MAIN);
+    lv_obj_add_event_cb(view->container, log_view_scroll_cb, LV_EVENT_SCROLL, view);
+
+    view->spacer = lv_obj_create(view->container);
+    lv_obj_remove_style_all(view->spacer);
+    lv_obj_clear_flag(view->spacer, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(view->spacer, 1, 0);
+
+    const lv_font_t *font = lv_obj_get_style_text_font(view->container, LV_PART_MAIN);
+    view->row_height = lv_font_get_line_height(font) + 2;
+    uint32_t rows = height / view->row_height + 2;
+    view->row_count = rows < LOG_VIEW_MAX_ROWS ? rows : LOG_VIEW_MAX_ROWS;
+
+    for (uint8_t i = 0; i < view->row_count; i++) {
+        lv_obj_t *row = lv_label_create(view->container);
+        lv_label_set_long_mode(row, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(row, lv_pct(100));
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        view->rows[i] = row;
+        view->row_line[i] = LOG_VIEW_NO_LINE;
+    }
+}
+
+static inline void log_view_append(log_view_t *view, const char *text, size_t len, uint8_t kind) {
+    log_ring_append(&view->ring, text, len, kind);
+    view->dirty = true;
+}
+
+// Applies pending appends: one layout pass per frame however many lines arrived
+static void log_view_flush(log_view_t *view) {
+    if (!view->dirty) return;
+    view->dirty = false;
+    lv_obj_set_height(view->spacer, (lv_coord_t)(log_ring_count(&view->ring) * view->row_height));
+    if (view->follow) {
+        lv_obj_update_layout(view->container);
+        lv_coord_t bottom = lv_obj_get_scroll_y(view->container) + lv_obj_get_scroll_bottom(view->container);
+        lv_obj_scroll_to_y(view->container, bottom, LV_ANIM_OFF);
+    }
+    log_view_sync_rows(view);
+}
+
+#endif // LOG_VIEW_H
@@ -0,0 +1,394 @@
+// MQTTOutbox.h - Bounded priority queue for outgoing MQTT payloads with a flash journal
+//
+// Every outgoing payload is queued with a priority (command acks > red > amber > green >
+// info) and a sequence number, and leaves the queue only once it has been published. Entries marked
+// persistent (alerts, command logs) are written to an append-only journal so they survive
+// a reboot and are replayed, highest priority first and in sequence order, once the
+// broker is reachable again. Also contains the reconnect backoff used by the connection
+// task.
+//
+// MQTTOutbox is not thread-safe: callers serialize access with their own lock. Journal
+// writes are split so the flash I/O runs outside that lock: prepareSync() copies the
+// missing records into a batch, writeSync() writes it, finishSync() records the result.
+// Journal functions are templates over the file system (SPIFFS on the device, any object
+// with the same open/exists/remove/rename API on a host).
+//
+// Sequence numbers restart after a reboot with an empty journal; payloads carry the boot
+// count from advanceBootCount() so (boot, seq) stays unique.
+
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "CRC32.h"
+#include "MQTTPayload.h"
+
+#ifndef MQTT_OUTBOX_CAPACITY
+#define MQTT_OUTBOX_CAPACITY 24
+#endif
+#define MQTT_OUTBOX_PAYLOAD_SIZE MQTT_PAYLOAD_BUFFER_SIZE
+#define MQTT_JOURNAL_PATH "/mqtt_outbox.log"
+#define MQTT_JOURNAL_TMP_PATH "/mqtt_outbox.tmp"
+#define MQTT_JOURNAL_MAX_BYTES 32768  // Compact the journal once it grows past this
+#define MQTT_JOURNAL_MAX_ACKS 16      // ACK records buffered between journal writes
+#define MQTT_BOOT_COUNT_PATH "/boot_count"
+#define MQTT_BOOT_COUNT_TMP_PATH "/boot_count.tmp"
+
+enum class OutboxPriority : uint8_t {
+  Info = 0,
+  Green = 1,
+  Amber = 2,
+  Red = 3,
+  Command = 4  // Command acks: small and latency-critical, sent ahead of everything
+};
+
+// Entry flags
+#define OUTBOX_PERSIST   0x01  // Keep in the flash journal until published
+#define OUTBOX_JOURNALED 0x02  // ENQ record already written
+#define OUTBOX_REPLAYED  0x04  // Restored from the journal after a reboot
+
+struct OutboxEntry {
+  uint32_t sequence;
+  uint8_t priority;
+  uint8_t topicMask;  // Bit i = topic i of the caller's topic table
+  uint8_t flags;
+  uint16_t published; // Publish targets already sent, see markPublished(); not journaled
+  uint16_t length;
+  char payload[MQTT_OUTBOX_PAYLOAD_SIZE];
+};
+
+// Journal records copied out of the queue by prepareSync()
+struct OutboxJournalBatch {
+  bool compact;  // Rewrite the journal with exactly these entries
+  uint8_t ackCount;
+  uint8_t entryCount;
+  uint32_t acks[MQTT_JOURNAL_MAX_ACKS];
+  OutboxEntry entries[MQTT_OUTBOX_CAPACITY];
+};
+
+struct OutboxStats {
+  uint32_t enqueued;
+  uint32_t published;
+  uint32_t dropped;          // Evicted or rejected because the queue was full
+  uint32_t replayed;         // Published entries that were restored from the journal
+  uint32_t journalWrites;
+  uint32_t compactions;
+  uint16_t depth;
+  uint16_t peakDepth;
+  uint32_t lastReplayMs;     // Time to drain the backlog after the last reconnect
+};
+
+class MQTTOutbox {
+ public:
+  uint32_t nextSequence() { return ++lastSequence; }
+
+  // Queue a serialized payload. When full, the oldest entry of the lowest priority is
+  // evicted if it is not more important than the new one; otherwise the new one is dropped.
+  bool enqueue(uint32_t sequence, OutboxPriority priority, uint8_t topicMask, bool persist,
+               const char* payload, size_t length) {
+    if (length > MQTT_OUTBOX_PAYLOAD_SIZE) length = MQTT_OUTBOX_PAYLOAD_SIZE;
+    int slot = freeSlot();
+    if (slot < 0) {
+      int victim = selectEntry(false);
+      if (victim < 0 || entries[victim].priority > (uint8_t)priority) {
+        stats.dropped++;
+        return false;
+      }
+      releaseEntry(victim);
+      stats.dropped++;
+      slot = victim;
+    }
+
+    OutboxEntry& e = entries[slot];
+    e.sequence = sequence;
+    e.priority = (uint8_t)priority;
+    e.topicMask = topicMask;
+    e.flags = persist ? OUTBOX_PERSIST : 0;
+    e.published = 0;
+    e.length = (uint16_t)length;
+    memcpy(e.payload, payload, length);
+    used[slot] = true;
+
+    stats.enqueued++;
+    stats.depth++;
+    if (stats.depth > stats.peakDepth) stats.peakDepth = stats.depth;
+    return true;
+  }
+
+  // Copy the next entry to publish (highest priority, then lowest sequence)
+  bool peek(OutboxEntry& out) const {
+    int next = selectEntry(true);
+    if (next < 0) return false;
+    out = entries[next];
+    return true;
+  }
+
+  // Remove a published entry
+  void acknowledge(uint32_t sequence) {
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      if (used[i] && entries[i].sequence == sequence) {
+        if (entries[i].flags & OUTBOX_REPLAYED) stats.replayed++;
+        stats.published++;
+        releaseEntry(i);
+        return;
+      }
+    }
+  }
+
+  // Record the publish targets a partly failed attempt did reach (bits chosen by the caller,
+  // e.g. MQTTPayload::publish()), so the retry skips them. Kept in RAM only: an entry
+  // replayed after a reboot goes to every target again.
+  void markPublished(uint32_t sequence, uint16_t published) {
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      if (used[i] && entries[i].sequence == sequence) {
+        entries[i].published |= published;
+        return;
+      }
+    }
+  }
+
+  uint16_t depth() const { return stats.depth; }
+  bool empty() const { return stats.depth == 0; }
+  OutboxStats& getStats() { return stats; }
+
+  // ===== Journal ===== //
+
+  // Rebuild the queue from the journal after a reboot
+  template <class FileSystem>
+  void load(FileSystem& fs) {
+    if (!fs.exists(MQTT_JOURNAL_PATH)) return;
+    auto file = fs.open(MQTT_JOURNAL_PATH, "r");
+    if (!file) return;
+
+    JournalRecord record;
+    char payload[MQTT_OUTBOX_PAYLOAD_SIZE];
+    while (file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+      if (record.magic != JOURNAL_MAGIC || record.length > MQTT_OUTBOX_PAYLOAD_SIZE) break;
+      if (record.length > 0 &&
+          file.read((uint8_t*)payload, record.length) != record.length) break;
+      if (record.crc != recordCRC(record, payload)) break;  // Torn write at the tail
+
+      if (record.sequence > lastSequence) lastSequence = record.sequence;
+      if (record.kind == JOURNAL_ENQUEUE) {
+        enqueue(record.sequence, (OutboxPriority)record.priority, record.topicMask, true,
+                payload, record.length);
+        int slot = findSequence(record.sequence);
+        if (slot >= 0) entries[slot].flags |= OUTBOX_JOURNALED | OUTBOX_REPLAYED;
+      } else if (record.kind == JOURNAL_ACK) {
+        int slot = findSequence(record.sequence);
+        if (slot >= 0) releaseEntry(slot);
+      }
+    }
+    file.close();
+
+    // Counters describe this boot only; rewrite the journal without acked records
+    stats.enqueued = 0;
+    stats.dropped = 0;
+    compactNeeded = true;
+  }
+
+  // Under the lock: copy the records the journal is missing into batch and mark them as
+  // journaled. Returns false when there is nothing to write.
+  bool prepareSync(OutboxJournalBatch& batch) {
+    batch.compact = compactNeeded || journalBytes > MQTT_JOURNAL_MAX_BYTES;
+    batch.ackCount = batch.compact ? 0 : ackCount;
+    memcpy(batch.acks, pendingAcks, batch.ackCount * sizeof(uint32_t));
+    ackCount = 0;
+    compactNeeded = false;
+
+    batch.entryCount = 0;
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      OutboxEntry& e = entries[i];
+      if (!used[i] || !(e.flags & OUTBOX_PERSIST)) continue;
+      if (!batch.compact && (e.flags & OUTBOX_JOURNALED)) continue;
+      batch.entries[batch.entryCount++] = e;
+      e.flags |= OUTBOX_JOURNALED;
+    }
+    return batch.compact || batch.ackCount > 0 || batch.entryCount > 0;
+  }
+
+  // Without the lock: append the batch, or rewrite the journal for a compaction. Entries
+  // acknowledged meanwhile get their ACK record in the next batch.
+  template <class FileSystem>
+  static bool writeSync(FileSystem& fs, const OutboxJournalBatch& batch, size_t& bytes) {
+    bytes = 0;
+    auto file = fs.open(batch.compact ? MQTT_JOURNAL_TMP_PATH : MQTT_JOURNAL_PATH, batch.compact ? "w" : "a");
+    if (!file) return false;
+    bool ok = true;
+    for (uint8_t i = 0; i < batch.ackCount; i++) {
+      ok &= writeRecord(file, JOURNAL_ACK, batch.acks[i], 0, 0, nullptr, 0, bytes);
+    }
+    for (uint8_t i = 0; i < batch.entryCount; i++) {
+      const OutboxEntry& e = batch.entries[i];
+      ok &= writeRecord(file, JOURNAL_ENQUEUE, e.sequence, e.priority, e.topicMask, e.payload, e.length, bytes);
+    }
+    file.close();
+    if (ok && batch.compact) {
+      fs.remove(MQTT_JOURNAL_PATH);
+      ok = fs.rename(MQTT_JOURNAL_TMP_PATH, MQTT_JOURNAL_PATH);
+    }
+    return ok;
+  }
+
+  // Under the lock: account for the written batch. After a failed write the whole journal
+  // is rewritten next time.
+  void finishSync(const OutboxJournalBatch& batch, bool ok, size_t bytes) {
+    if (!ok) {
+      compactNeeded = true;
+      return;
+    }
+    journalBytes = batch.compact ? bytes : journalBytes + bytes;
+    stats.journalWrites += batch.ackCount + batch.entryCount;
+    if (batch.compact) stats.compactions++;
+  }
+
+  // All three steps, for callers that own the queue exclusively
+  template <class FileSystem>
+  bool sync(FileSystem& fs, OutboxJournalBatch& batch) {
+    if (!prepareSync(batch)) return false;
+    size_t bytes;
+    bool ok = writeSync(fs, batch, bytes);
+    finishSync(batch, ok, bytes);
+    return ok;
+  }
+
+ private:
+  static const uint8_t JOURNAL_MAGIC = 0xA5;
+  static const uint8_t JOURNAL_ENQUEUE = 1;
+  static const uint8_t JOURNAL_ACK = 2;
+
+  struct JournalRecord {
+    uint8_t magic;
+    uint8_t kind;
+    uint8_t priority;
+    uint8_t topicMask;
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t reserved;
+    uint32_t crc;  // Over the record with crc = 0, then the payload
+  };
+
+  OutboxEntry entries[MQTT_OUTBOX_CAPACITY];
+  bool used[MQTT_OUTBOX_CAPACITY] = {};
+  uint32_t lastSequence = 0;
+  uint32_t pendingAcks[MQTT_JOURNAL_MAX_ACKS];
+  uint8_t ackCount = 0;
+  bool compactNeeded = false;
+  size_t journalBytes = 0;
+  OutboxStats stats = {};
+
+  int freeSlot() const {
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      if (!used[i]) return i;
+    }
+    return -1;
+  }
+
+  int findSequence(uint32_t sequence) const {
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      if (used[i] && entries[i].sequence == sequence) return i;
+    }
+    return -1;
+  }
+
+  // highest = true: next to publish; false: eviction victim (lowest priority, oldest)
+  int selectEntry(bool highest) const {
+    int best = -1;
+    for (int i = 0; i < MQTT_OUTBOX_CAPACITY; i++) {
+      if (!used[i]) continue;
+      if (best < 0) {
+        best = i;
+        continue;
+      }
+      const OutboxEntry& e = entries[i];
+      const OutboxEntry& b = entries[best];
+      bool better = highest ? e.priority > b.priority : e.priority < b.priority;
+      if (better || (e.priority == b.priority && (int32_t)(e.sequence - b.sequence) < 0)) best = i;
+    }
+    return best;
+  }
+
+  // Frees a slot; journaled entries get an ACK record so they are not replayed again
+  void releaseEntry(int slot) {
+    if (entries[slot].flags & OUTBOX_JOURNALED) {
+      if (ackCount < MQTT_JOURNAL_MAX_ACKS) {
+        pendingAcks[ackCount++] = entries[slot].sequence;
+      } else {
+        compactNeeded = true;
+      }
+    }
+    used[slot] = false;
+    stats.depth--;
+  }
+
+  static uint32_t recordCRC(JournalRecord record, const char* payload) {
+    record.crc = 0;
+    uint32_t crc = crc32Update(0, &record, sizeof(record));
+    return crc32Update(crc, payload, record.length);
+  }
+
+  template <class File>
+  static bool writeRecord(File& file, uint8_t kind, uint32_t sequence, uint8_t priority, uint8_t topicMask,
+                          const char* payload, uint16_t length, size_t& bytes) {
+    JournalRecord record = {JOURNAL_MAGIC, kind, priority, topicMask, sequence, length, 0, 0};
+    record.crc = recordCRC(record, payload);
+    size_t written = file.write((const uint8_t*)&record, sizeof(record));
+    if (length > 0) written += file.write((const uint8_t*)payload, length);
+    bytes += written;
+    return written == sizeof(record) + length;
+  }
+};
+
+// ===== Reconnect backoff ===== //
+// Exponential backoff with "equal jitter": the delay for attempt n is uniformly drawn from
+// [d/2, d] where d = min(base * 2^n, max). The caller supplies the random value.
+class ReconnectBackoff {
+ public:
+  ReconnectBackoff(uint32_t baseMs, uint32_t maxMs) : baseMs(baseMs), maxMs(maxMs) {}
+
+  uint32_t nextDelay(uint32_t randomValue) {
+    uint32_t delayMs = maxMs;
+    if (attempt < 20 && (baseMs << attempt) < maxMs) delayMs = baseMs << attempt;
+    if (attempt < 255) attempt++;
+    uint32_t half = delayMs / 2;
+    return half + (half ? randomValue % (half + 1) : 0);
+  }
+
+  void reset() { attempt = 0; }
+  uint8_t attempts() const { return attempt; }
+
+ private:
+  uint32_t baseMs;
+  uint32_t maxMs;
+  uint8_t attempt = 0;
+};
+
+// ===== Boot counter ===== //
+// Increments the boot count kept next to the journal and returns it (never 0). Written to a
+// temporary file first so a reset during the write cannot lose the count.
+template <class FileSystem>
+uint32_t advanceBootCount(FileSystem& fs) {
+  uint32_t count = 0;
+  const char* path = fs.exists(MQTT_BOOT_COUNT_PATH) ? MQTT_BOOT_COUNT_PATH : MQTT_BOOT_COUNT_TMP_PATH;
+  if (fs.exists(path)) {
+    auto file = fs.open(path, "r");
+    if (file) {
+      if (file.read((uint8_t*)&count, sizeof(count)) != sizeof(count)) count = 0;
+      file.close();
+    }
+  }
+  if (++count == 0) count = 1;
+
+  auto file = fs.open(MQTT_BOOT_COUNT_TMP_PATH, "w");
+  if (file) {
+    file.write((const uint8_t*)&count, sizeof(count));
+    file.close();
+    fs.remove(MQTT_BOOT_COUNT_PATH);
+    fs.rename(MQTT_BOOT_COUNT_TMP_PATH, MQTT_BOOT_COUNT_PATH);
+  }
+  return count;
+}
+
+#endif // MQTT_OUTBOX_H
@@ -0,0 +1,207 @@
+// MQTTPayload.h - Zero-heap JSON payload serializer for MQTT publishing
+//
+// Serializes one flat JSON object into a fixed, reusable buffer with proper string
+// escaping, then publishes the same encoded bytes to every target topic. Keeps running
+// counters so heap-free publishing can be monitored in the field.
+//
+// Serializing and the counters share the caller's lock. publish() sends a payload the caller
+// has already copied out and touches no state, so it can run on another task without the
+// lock; that task reports the outcome with recordPublishes() once it holds the lock again.
+//
+// No Arduino dependencies: any client with publish(topic, const uint8_t*, unsigned int)
+// (PubSubClient or a host-side stand-in) can be used with publish().
+
+#ifndef MQTT_PAYLOAD_H
+#define MQTT_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MQTT_PAYLOAD_BUFFER_SIZE 512
+
+struct MQTTPublishStats {
+  uint32_t events;           // Payloads serialized
+  uint32_t bytesSerialized;  // Total payload bytes serialized
+  uint32_t publishes;        // Successful publish() calls
+  uint32_t publishFailures;  // Failed publish() calls
+  uint32_t truncated;        // Payloads that did not fit and were cut short
+  size_t peakBufferUse;      // Largest payload seen, in bytes
+};
+
+class MQTTPayload {
+ public:
+  // Start a new JSON object, discarding the previous payload
+  void begin() {
+    len = 0;
+    overflow = false;
+    firstField = true;
+    buf[len++] = '{';
+    buf[len] = '\0';
+  }
+
+  // Add "key":"value" with the value JSON-escaped. A value that does not fit is cut short.
+  void add(const char* key, const char* value) {
+    if (!openField(key, 1)) return;
+    appendRaw("\"");
+    appendEscaped(value ? value : "");
+    appendRaw("\"");
+  }
+
+  // Add "key":number
+  void addNumber(const char* key, long value) {
+    char num[24];
+    snprintf(num, sizeof(num), "%ld", value);
+    if (!openField(key, strlen(num))) return;
+    appendRaw(num);
+  }
+
+  // Add "key":number for counters; long is 32 bits on the ESP32, so values past 2^31 need this
+  void addUnsigned(const char* key, uint32_t value) {
+    char num[12];
+    snprintf(num, sizeof(num), "%lu", (unsigned long)value);
+    if (!openField(key, strlen(num))) return;
+    appendRaw(num);
+  }
+
+  // Add "key":true/false
+  void addBool(const char* key, bool value) {
+    if (!openField(key, 5)) return;
+    appendRaw(value ? "true" : "false");
+  }
+
+  // Close the object and update the counters. Returns the encoded payload.
+  const char* finish() {
+    buf[len++] = '}';  // Room is always reserved for the closing brace
+    buf[len] = '\0';
+    stats.events++;
+    stats.bytesSerialized += len;
+    if (overflow) stats.truncated++;
+    if (len > stats.peakBufferUse) stats.peakBufferUse = len;
+    return buf;
+  }
+
+  // Publish a payload serialized earlier (e.g. copied out of a queue) to each topic. Returns the
+  // number of successful publishes; the counters are left to recordPublishes().
+  template <class Client>
+  static uint8_t publish(Client& client, const char* const* topics, uint8_t topicCount,
+                         const char* payload, size_t length) {
+    uint16_t published = 0;
+    return publish(client, topics, topicCount, payload, length, published);
+  }
+
+  // Same, skipping the topics whose bit is set in published (bit i = topics[i], up to 16) and
+  // setting the bit of each topic sent, so a retry resends only the topics that failed.
+  template <class Client>
+  static uint8_t publish(Client& client, const char* const* topics, uint8_t topicCount,
+                         const char* payload, size_t length, uint16_t& published) {
+    uint8_t sent = 0;
+    for (uint8_t i = 0; i < topicCount; i++) {
+      if (published & (1u << i)) continue;
+      if (client.publish(topics[i], (const uint8_t*)payload, (unsigned int)length)) {
+        published |= (uint16_t)(1u << i);
+        sent++;
+      }
+    }
+    return sent;
+  }
+
+  void recordPublishes(uint8_t sent, uint8_t failed) {
+    stats.publishes += sent;
+    stats.publishFailures += failed;
+  }
+
+  const char* c_str() const { return buf; }
+  size_t length() const { return len; }
+  bool overflowed() const { return overflow; }
+  const MQTTPublishStats& getStats() const { return stats; }
+
+ private:
+  // Bytes always kept free for a closing quote, the closing brace and the null terminator
+  static const size_t RESERVED = 3;
+
+  char buf[MQTT_PAYLOAD_BUFFER_SIZE];
+  size_t len = 0;
+  bool overflow = false;
+  bool firstField = true;
+  MQTTPublishStats stats = {};
+
+  bool fits(size_t n) const { return len + n + RESERVED <= sizeof(buf); }
+
+  // Writes the separator and "key": if there is room for it and valueLen more bytes
+  bool openField(const char* key, size_t valueLen) {
+    size_t keyLen = strlen(key);
+    if (overflow || !fits(keyLen + 4 + valueLen)) {  // ,"key":
+      overflow = true;
+      return false;
+    }
+    if (!firstField) buf[len++] = ',';
+    firstField = false;
+    buf[len++] = '"';
+    memcpy(buf + len, key, keyLen);
+    len += keyLen;
+    buf[len++] = '"';
+    buf[len++] = ':';
+    buf[len] = '\0';
+    return true;
+  }
+
+  // Space for raw values is checked by openField() or covered by RESERVED
+  void appendRaw(const char* s) {
+    size_t n = strlen(s);
+    memcpy(buf + len, s, n);
+    len += n;
+    buf[len] = '\0';
+  }
+
+  void appendEscaped(const char* s) {
+    size_t start = len;
+    for (; *s; s++) {
+      unsigned char c = (unsigned char)*s;
+      char esc[7];
+      size_t n;
+      switch (c) {
+        case '"':  n = 2; esc[0] = '\\'; esc[1] = '"'; break;
+        case '\\': n = 2; esc[0] = '\\'; esc[1] = '\\'; break;
+        case '\n': n = 2; esc[0] = '\\'; esc[1] = 'n'; break;
+        case '\r': n = 2; esc[0] = '\\'; esc[1] = 'r'; break;
+        case '\t': n = 2; esc[0] = '\\'; esc[1] = 't'; break;
+        case '\b': n = 2; esc[0] = '\\'; esc[1] = 'b'; break;
+        case '\f': n = 2; esc[0] = '\\'; esc[1] = 'f'; break;
+        default:
+          if (c < 0x20) {
+            n = 6;
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+          } else {
+            n = 1;
+            esc[0] = (char)c;
+          }
+          break;
+      }
+      if (!fits(n)) {
+        overflow = true;
+        trimPartialUTF8(start);
+        break;
+      }
+      memcpy(buf + len, esc, n);
+      len += n;
+    }
+    buf[len] = '\0';
+  }
+
+  // Drop a multi-byte UTF-8 sequence left incomplete by truncation
+  void trimPartialUTF8(size_t start) {
+    size_t i = len;
+    while (i > start && ((unsigned char)buf[i - 1] & 0xC0) == 0x80) i--;
+    if (i == start || i == len) {
+      if (i > start && (unsigned char)buf[i - 1] >= 0xC0) len = i - 1;  // Lone lead byte
+      return;
+    }
+    unsigned char lead = (unsigned char)buf[i - 1];
+    size_t expected = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : (lead >= 0xC0) ? 2 : 1;
+    if (len - (i - 1) < expected) len = i - 1;
+  }
+};
+
+#endif // MQTT_PAYLOAD_H
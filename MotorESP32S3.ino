@@ -10,7 +10,18 @@
 #include <WiFiClientSecure.h>  // Add WiFiClientSecure for SSL/TLS
 #include <ArduinoJson.h>  // Add ArduinoJson library for JSON parsing
 #include <esp_task_wdt.h>
+#include <soc/gpio_reg.h>  // GPIO input registers read from the LED edge ISR
 #include <ESPmDNS.h>
+#include "LEDAlarmDecoder.h"  // Table-driven LED alarm decoder
+#include "MQTTPayload.h"  // Zero-heap JSON payload serializer
+#include "LEDCapture.h"  // Interrupt-driven LED edge capture and classification
+#include "MQTTOutbox.h"  // Priority outbox with flash journal and reconnect backoff
+#include "CommandFrame.h"  // Binary command frame shared with the HMI
+#include "CommandStats.h"  // Command sequence filter and latency histograms
+#include "EventStore.h"  // Segmented event log on SPIFFS with time-range queries
+#include "StatusModel.h"  // Versioned status for delta polling and event streams
+#include "ControllerLogic.h"  // Button debounce, alarm gating and loop timing
+#include "FleetDispatch.h"  // Per-unit topics for one HMI supervising many lifts
 
 // ===== Login Configuration ===== //
 const char* www_username = "admin";     
@@ -31,15 +42,29 @@ const char* generalLogTopic = "usf/logs/general";
 const char* commandLogTopic = "usf/logs/command";
 const char* alertLogTopic = "usf/logs/alerts";
 
+// Fleet unit id: every topic is also published as usf/unit/<unitId>/... (see FleetDispatch.h)
+const char* unitName = "";  // Empty: "lift-" and the last three bytes of the MAC
+const bool publishSingleLiftTopics = true;  // Keep the usf/... topics the web dashboard uses
+// Commands on topics every unit shares: frames on CMD_FRAME_TOPIC and the legacy JSON
+// commands on the usf/logs/... topics. Off so one publish cannot move every lift in the
+// fleet; only frames on this unit's own topic are executed. The HMI and the web dashboard
+// (mqtt-dashboard.js) both send frames there.
+const bool acceptBroadcastCommands = false;
+char unitId[FLEET_UNIT_ID_MAX + 1];
+
 // --- Function Prototypes ---
 void addToLog(const String &message);
-void flushLogBuffer();
+void recordEvent(EventType type, const char* text, bool flushNow);
+void publishMessage(const char* message);
 void publishMessage(const String& message);
+void publishGeneralLog(const char* msg, const char* type);
 void publishGeneralLog(const String& msg, const char* type);
+void publishCommandLog(const char* msg);
 void publishCommandLog(const String& msg);
+void publishAlert(const char* level, const char* msg);
 void publishAlert(const char* level, const String& msg);
 void callback(char* topic, byte* payload, unsigned int length);
-void processLEDStatus(const String& tempStatus, unsigned long currentMillis);
+void processLEDStatus(LEDStateWord ledWord, unsigned long currentMillis);
 
 // EMQX Root CA Certificate
 static const char* root_ca PROGMEM = R"EOF(
@@ -73,20 +98,12 @@ const char* ntpServer = "pool.ntp.org";
 const long  gmtOffset_sec = -5 * 3600; // EST (change to -4*3600 for EDT, etc.)
 const int   daylightOffset_sec = 3600; // 1 hour daylight savings
 
-// ESP-NOW message structure
-typedef struct struct_message {
-  char type[16];
-  char payload[100];
-} struct_message;
-
-struct_message incomingDataStruct;
-
 unsigned long lastHealthCheck = 0;
 const unsigned long HEALTH_CHECK_INTERVAL = 300000; // Changed to 5 minutes (300000ms)
 // Timing Configuration (ms)
 unsigned long LIFT_MODE_DELAY = 100; // Reduced from 200ms to 100ms
 unsigned long ELEVATOR_MODE_DELAY = 100; // Reduced from 200ms to 100ms
-const unsigned long LED_CHECK_DELAY = 50; // Reduced from 300ms to 50ms
+const unsigned long LED_CLASSIFY_PERIOD_MS = 5; // LED capture task classification period
 const unsigned long checkInterval = 500; // Reduced from 1500ms to 500ms
 
 // Pin Definitions
@@ -113,34 +130,83 @@ const int redLEDs[] = {20, 47, 45, 39}; // Array of pin numbers for Red LEDs
 const int greenLEDs[] = {21, 48, 35, 37}; // Array of pin numbers for Green LEDs
 const int numLEDs = 4; // Total LEDs per color
 
-// Timing variables for LED reading
-unsigned long previousMillis = 0; // // Variable to store the last time LED status was updated
-
 // Variables to track LED states
 bool lastStateRed[numLEDs] = {LOW, LOW, LOW, LOW}; // Array to store last read state of each Red LED
 bool lastStateGreen[numLEDs] = {LOW, LOW, LOW, LOW}; // Array to store last read state of each Green LED
 int changeCountRed[numLEDs] = {0, 0, 0, 0}; // Array to count state changes for Red LEDs
 int changeCountGreen[numLEDs] = {0, 0, 0, 0}; // Array to count state changes for Green LEDs
 
-// Global variable to hold LED status for the web UI
-String ledStatus = ""; // This string will be updated with LED status info for the webpage
-
 // ===== Global Variables ===== //
-String serialLogs; // Stored Logs on to send to the web interface
 bool elevatorMode = false; // Track the mode
 String currentDirection = "none"; // Track current movement direction
-String greenAlarms = "";  // Green alarm messages
-String amberAlarms = "";  // Amber alarm messages
-String redAlarms = "";    // Red alarm messages
 unsigned long lastActionTime = 0; // Track when last action was made
-String ledStatusHistory = "";
-String lastLedSnapshot = "";
+char lastLedSnapshot[64] = "";
 String lastRedEmailSent = "";
 String lastAmberEmailSent = "";
 String lastGreenEmailSent = "";
 
 WiFiClientSecure espClient;
 PubSubClient mqttClient(espClient);
+MQTTPayload mqttPayload;  // Shared, reusable buffer for outgoing JSON payloads
+MQTTOutbox mqttOutbox;    // Payloads waiting for the broker, persisted to SPIFFS
+SemaphoreHandle_t outboxMutex = NULL;  // Guards mqttPayload and mqttOutbox
+EventStore eventStore;    // Logs, LED history, alarms and commands, kept on SPIFFS
+SemaphoreHandle_t eventStoreMutex = NULL;  // Guards eventStore
+StatusModel statusModel;  // LED status, alarms and settings as served by /status and /stream
+SemaphoreHandle_t statusMutex = NULL;  // Guards statusModel
+uint32_t bootId = 0;      // Boot count from SPIFFS: "boot" in payloads, pairs with statusModel.sequence() in ETags
+ReconnectBackoff mqttBackoff(1000, 60000);  // 1 s doubling up to 60 s, with jitter
+volatile bool mqttConnected = false;  // Written by the MQTT task only
+uint32_t mqttReconnects = 0;
+
+// Outbox topic table; publishEvent() selects targets with a bit mask over this table
+const char* emailAlertTopic = "usf/alerts/email";
+const char* commandMetricsTopic = "usf/metrics/commands";
+const char* loopMetricsTopic = "usf/metrics/loop";
+const char* const outboxTopics[] = {mqttTopic, generalLogTopic, commandLogTopic, alertLogTopic, emailAlertTopic,
+                                    CMD_ACK_TOPIC, commandMetricsTopic, loopMetricsTopic};
+const uint8_t OUTBOX_TOPIC_COUNT = sizeof(outboxTopics) / sizeof(outboxTopics[0]);
+static_assert(sizeof(outboxTopics) / sizeof(outboxTopics[0]) * 2 <= 16, "OutboxEntry::published has a bit per publish target");
+#define TOPIC_MESSAGES 0x01
+#define TOPIC_GENERAL  0x02
+#define TOPIC_COMMAND  0x04
+#define TOPIC_ALERT    0x08
+#define TOPIC_EMAIL    0x10
+#define TOPIC_CMD_ACK  0x20
+#define TOPIC_METRICS  0x40
+#define TOPIC_LOOP_METRICS 0x80
+char unitTopics[OUTBOX_TOPIC_COUNT][FLEET_TOPIC_MAX];  // outboxTopics under usf/unit/<unitId>/
+char unitFrameTopic[FLEET_TOPIC_MAX];  // Command frames for this unit only
+char unitEspNowTopic[FLEET_TOPIC_MAX]; // This unit's ESP-NOW MAC for HMIs, with CMD_FRAME_ESPNOW
+
+const unsigned long MQTT_TASK_PERIOD_MS = 10;  // MQTT task poll period
+const unsigned long WIFI_RETRY_INTERVAL = 5000;  // WiFi.begin() retry while disconnected
+const uint8_t MQTT_DRAIN_BATCH = 8;  // Outbox entries published per MQTT task iteration
+const unsigned long OUTBOX_LOCK_TIMEOUT_MS = 20;  // Longest a producer waits for outboxMutex
+std::atomic<uint32_t> outboxLockDrops{0};  // Events dropped because outboxMutex timed out
+
+// Command frames (see CommandFrame.h)
+const unsigned long COMMAND_METRICS_INTERVAL = 60000;  // Latency metrics publish period
+const uint64_t COMMAND_LATENCY_MAX_US = 60000000ULL;   // Larger values mean unsynced clocks
+CommandSequencer commandSequencer;
+LatencyHistogram commandLatency[CMD_TRANSPORT_COUNT];  // Frame send -> relay output edge
+CommandTransportStats commandStats[CMD_TRANSPORT_COUNT];
+portMUX_TYPE commandStatsMux = portMUX_INITIALIZER_UNLOCKED;  // Guards the three above
+const unsigned long COMMAND_INTERLOCK_WAIT_MS = 20;  // Longest loop() waits to queue an interlock stop
+
+// Every command source (MQTT frames, dashboard JSON, ESP-NOW, LED interlocks) only validates
+// and posts to commandQueue; commandTask is the only caller of executeCommand().
+struct QueuedCommand {
+    command_frame_t frame;           // Dashboard JSON commands and interlocks only set frame.opcode
+    uint8_t transport;               // CommandTransport
+    bool framed;                     // false: JSON command, no sequence or ack
+    bool interlock;                  // LED interlock releasing the command outputs
+    uint8_t mac[ESP_NOW_ETH_ALEN];   // ESP-NOW sender, for the ack
+    uint32_t receivedUs;
+};
+const uint8_t COMMAND_QUEUE_LENGTH = 8;
+QueueHandle_t commandQueue = NULL;
+std::atomic<uint32_t> commandQueueDrops{0};  // Commands dropped because the queue was full
 
 // Topics for MQTT
 const char* alarmTopic = "usf/alarms";
@@ -149,33 +215,46 @@ const char* statusTopic = "usf/status";
 // LED state structure
 struct LEDState {
     bool currentState;
-    bool lastState;
-    int changeCount;
-    unsigned long lastChange;
+    bool flashing;
+    uint16_t frequencyCentiHz;  // Measured flash frequency, 0 when steady
 };
 
 // LED states arrays
 LEDState redLEDStates[4];
 LEDState greenLEDStates[4];
 
-// Alert system configuration
-#define ALERT_COOLDOWN 5000        // 5 seconds between different alerts
-#define ALERT_DEBOUNCE_TIME 1000   // 1 second debounce for state changes
-#define MAX_ALERT_HISTORY 50       // Maximum number of alerts to keep in memory
-
-// Alert tracking structure
-struct AlertState {
-    String message;
-    unsigned long lastChangeTime;
-    unsigned long lastPublishTime;
-    bool isActive;
-    int stableCount;
+// LED capture pipeline (see LEDCapture.h)
+SPSCRing<LEDEdge, 256> ledEdgeRing;          // ISR -> capture task
+SPSCRing<LEDSnapshot, 16> ledSnapshotRing;   // Capture task -> loop()
+LEDClassifier ledClassifier;                 // Capture task only
+LEDCaptureStats ledCaptureStats = {};        // Capture task's copy for the web task
+portMUX_TYPE ledCaptureMux = portMUX_INITIALIZER_UNLOCKED;  // Guards ledCaptureStats
+
+// Relay outputs (see ControllerLogic.h): the button outputs belong to loop(), the command
+// outputs to commandTask; either may read the other pair's upActive()/downActive()
+struct PinRelays {
+    void write(uint8_t pin, bool on) { digitalWrite(pin, on ? HIGH : LOW); }
+    void wait(uint32_t us) { delay((us + 999) / 1000); }
+    uint32_t nowUs() { return micros(); }
+};
+PinRelays pinRelays;
+RelayPair<PinRelays> buttonRelays(pinRelays, UP_PIN, DOWN_PIN, RELAY_REVERSE_DEADTIME_US);
+RelayPair<PinRelays> commandRelays(pinRelays, UP_OUTPUT_PIN, DOWN_OUTPUT_PIN, RELAY_REVERSE_DEADTIME_US);
+
+// LED interlocks and alerts; loop() task only
+struct LEDAlarmOutputs {
+    void interlock(uint8_t flags);
+    void alert(AlarmCode code);
 };
+LEDAlarmOutputs ledAlarmOutputs;
+LEDAlarmHandler ledAlarms;
+LEDStatusText ledStatusText;
+ButtonPanel buttonPanel(BUTTON_DEBOUNCE_MS);
 
-// Global alert states
-AlertState redAlertState;
-AlertState amberAlertState;
-AlertState greenAlertState;
+// Loop and relay timing, published with the command metrics
+LoopStats loopStats;          // Written by loop(), read by the web task under loopStatsMux
+portMUX_TYPE loopStatsMux = portMUX_INITIALIZER_UNLOCKED;
+InterlockStats interlockStats = {};  // Guarded by commandStatsMux
 
 // Global variables for alarm states
 String currentRedAlarms = "";
@@ -183,49 +262,31 @@ String currentGreenAlarms = "";
 String currentAmberAlarms = "";
 
 // Function declarations
-void stopUpMovement();
-void stopDownMovement();
 void stopMovement();
 void handleMovement(const char* direction);
 void applyBrake();
 void releaseBrake();
 
-// Get timestamp function
-String getTimestamp() {
+// Format the current time into a caller-supplied buffer
+const size_t TIMESTAMP_SIZE = 32;
+void formatTimestamp(char* buffer, size_t size) {
   struct tm timeinfo;
   if(!getLocalTime(&timeinfo)){
-    return "Failed to obtain time";
-  }
-  char timeStringBuff[50];
-  strftime(timeStringBuff, sizeof(timeStringBuff), "%Y-%m-%d %H:%M:%S", &timeinfo);
-  return String(timeStringBuff);
-}
-
-// Movement control functions
-void stopUpMovement() {
-  digitalWrite(UP_PIN, LOW);
-  if (currentDirection == "up") {
-    currentDirection = "none";
-    addToLog("Stopped upward movement");
-  }
-}
-
-void stopDownMovement() {
-  digitalWrite(DOWN_PIN, LOW);
-  if (currentDirection == "down") {
-    currentDirection = "none";
-    addToLog("Stopped downward movement");
+    strlcpy(buffer, "Failed to obtain time", size);
+    return;
   }
+  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
 }
 
+// Movement control functions: the button outputs, driven from loop() only
 void stopMovement() {
   // Add prominent Serial output for stop command
   Serial.println("\n=== LIFT COMMAND RECEIVED ===");
   Serial.println("Direction: STOP");
   Serial.println("===========================\n");
   
-  digitalWrite(UP_PIN, LOW);
-  digitalWrite(DOWN_PIN, LOW);
+  uint32_t gapUs;
+  buttonRelays.execute(CMD_OP_STOP, gapUs);
   currentDirection = "stop";
   addToLog("Movement stopped");
   publishCommandLog("Command executed: STOP");
@@ -233,24 +294,21 @@ void stopMovement() {
 }
 
 void handleMovement(const char* direction) {
-  String dir = String(direction);
-  
   // Add prominent Serial output for lift commands
   Serial.println("\n=== LIFT COMMAND RECEIVED ===");
   Serial.print("Direction: ");
-  Serial.println(dir);  // Print direction as is, Arduino String class handles uppercase automatically
+  Serial.println(direction);
   Serial.println("===========================\n");
   
-  if (dir == "up") {
-    digitalWrite(DOWN_PIN, LOW);
-    digitalWrite(UP_PIN, HIGH);
+  uint32_t gapUs;  // Reversals break before make, like the command outputs
+  if (strcmp(direction, "up") == 0) {
+    buttonRelays.execute(CMD_OP_UP, gapUs);
     currentDirection = "up";
     addToLog("Moving up");
     publishCommandLog("Command executed: UP");
     publishGeneralLog("Moving up", "info");
-  } else if (dir == "down") {
-    digitalWrite(UP_PIN, LOW);
-    digitalWrite(DOWN_PIN, HIGH);
+  } else if (strcmp(direction, "down") == 0) {
+    buttonRelays.execute(CMD_OP_DOWN, gapUs);
     currentDirection = "down";
     addToLog("Moving down");
     publishCommandLog("Command executed: DOWN");
@@ -268,61 +326,95 @@ void releaseBrake() {
   addToLog("Brake released");
 }
 
+// Producers wait at most OUTBOX_LOCK_TIMEOUT_MS for the outbox. The MQTT task holds the lock
+// only for queue operations, so a timeout drops the event and counts it instead of stalling loop().
+bool takeOutboxLock() {
+  if (xSemaphoreTake(outboxMutex, pdMS_TO_TICKS(OUTBOX_LOCK_TIMEOUT_MS)) == pdTRUE) return true;
+  outboxLockDrops++;
+  return false;
+}
+
+// Serializes one log event into the shared payload buffer and queues it for every topic in
+// topicMask. Never blocks on the network: the MQTT task publishes the outbox. Persistent
+// events are journaled to SPIFFS and survive a reboot while the broker is unreachable.
+void publishEvent(const char* type, const char* alertType, const char* msg, const char* ledCode,
+                  uint8_t topicMask, OutboxPriority priority, bool persist) {
+  char timestamp[TIMESTAMP_SIZE];
+  formatTimestamp(timestamp, sizeof(timestamp));
+
+  if (!takeOutboxLock()) return;
+  uint32_t seq = mqttOutbox.nextSequence();
+  mqttPayload.begin();
+  mqttPayload.addUnsigned("boot", bootId);
+  mqttPayload.addUnsigned("seq", seq);
+  mqttPayload.add("type", type);
+  if (alertType) mqttPayload.add("alert_type", alertType);
+  mqttPayload.add("message", msg);
+  if (ledCode) mqttPayload.add("led_code", ledCode);
+  mqttPayload.add("timestamp", timestamp);
+  mqttPayload.finish();
+  mqttOutbox.enqueue(seq, priority, topicMask, persist, mqttPayload.c_str(), mqttPayload.length());
+  xSemaphoreGive(outboxMutex);
+}
+
+// Outbox priority for an alert level: red before amber before green before info
+OutboxPriority alertPriority(const char* level) {
+  if (strcmp(level, "red") == 0) return OutboxPriority::Red;
+  if (strcmp(level, "amber") == 0) return OutboxPriority::Amber;
+  if (strcmp(level, "green") == 0) return OutboxPriority::Green;
+  return OutboxPriority::Info;
+}
+
 // Function to publish message via MQTT
-void publishMessage(const String& message) {
-  if (!mqttClient.connected()) return;
-  String payload = "{\"type\":\"info\",\"message\":\"" + message + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
-  mqttClient.publish(mqttTopic, payload.c_str());
-  mqttClient.publish(generalLogTopic, payload.c_str()); // Also send to general log
+void publishMessage(const char* message) {
+  publishEvent("info", nullptr, message, nullptr, TOPIC_MESSAGES | TOPIC_GENERAL, // Also send to general log
+               OutboxPriority::Info, false);
 }
-    
-  
 
+void publishMessage(const String& message) {
+  publishMessage(message.c_str());
+}
 
 // General log (info, error, warning, success)
+void publishGeneralLog(const char* msg, const char* type) {
+  publishEvent(type, nullptr, msg, nullptr, TOPIC_GENERAL | TOPIC_MESSAGES, // Also send to main topic
+               OutboxPriority::Info, false);
+}
+
 void publishGeneralLog(const String& msg, const char* type) {
-  if (!mqttClient.connected()) return;
-  String payload = "{\"type\":\"" + String(type) + "\",\"message\":\"" + msg + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
-  mqttClient.publish(generalLogTopic, payload.c_str());
-  mqttClient.publish(mqttTopic, payload.c_str()); // Also send to main topic
+  publishGeneralLog(msg.c_str(), type);
 }
 
 // Command log
+void publishCommandLog(const char* msg) {
+  publishEvent("command", nullptr, msg, nullptr, TOPIC_COMMAND | TOPIC_MESSAGES, // Also send to main topic
+               OutboxPriority::Info, true);
+}
+
 void publishCommandLog(const String& msg) {
-  if (!mqttClient.connected()) return;
-  String payload = "{\"type\":\"command\",\"message\":\"" + msg + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
-  mqttClient.publish(commandLogTopic, payload.c_str());
-  mqttClient.publish(mqttTopic, payload.c_str()); // Also send to main topic
+  publishCommandLog(msg.c_str());
 }
 
 // Alert console log (red, amber, green)
-void publishAlert(const char* level, const String& msg) {
-    if (!mqttClient.connected()) return;
-
-    // Create LED status code string
-    String ledCode = "";
+// One payload goes to the alert topic and to the general topic for the general tab.
+void publishAlert(const char* level, const char* msg) {
+    // Create LED status code string, e.g. "1000-0110"
+    char ledCode[numLEDs * 2 + 2];
+    int pos = 0;
     for (int i = 0; i < numLEDs; i++) {
-        ledCode += String(redLEDStates[i].lastState ? "1" : "0");
+        ledCode[pos++] = redLEDStates[i].currentState ? '1' : '0';
     }
-    ledCode += "-";
+    ledCode[pos++] = '-';
     for (int i = 0; i < numLEDs; i++) {
-        ledCode += String(greenLEDStates[i].lastState ? "1" : "0");
+        ledCode[pos++] = greenLEDStates[i].currentState ? '1' : '0';
     }
+    ledCode[pos] = '\0';
 
-    // Create alert message
-    String alertMsg = String(level) + " Alert: " + msg;
-    
-    // Create JSON payload for alert topic
-    String alertPayload = "{\"type\":\"" + String(level) + "\",\"message\":\"" + msg + "\",\"led_code\":\"" + ledCode + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
-    
-    // Create JSON payload for general topic with alert type
-    String generalPayload = "{\"type\":\"alert\",\"alert_type\":\"" + String(level) + "\",\"message\":\"" + msg + "\",\"led_code\":\"" + ledCode + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
+    publishEvent(level, level, msg, ledCode, TOPIC_ALERT | TOPIC_GENERAL, alertPriority(level), true);
 
-    // Publish to alert topic
-    mqttClient.publish(alertLogTopic, alertPayload.c_str());
-    
-    // Also publish to general topic for the general tab
-    mqttClient.publish(generalLogTopic, generalPayload.c_str());
+    char alarmText[128];
+    snprintf(alarmText, sizeof(alarmText), "%s: %s", level, msg);
+    recordEvent(EventType::Alarm, alarmText, true);
     
     // Log to serial for debugging
     Serial.print("Publishing ");
@@ -331,8 +423,279 @@ void publishAlert(const char* level, const String& msg) {
     Serial.println(msg);
 }
 
+void publishAlert(const char* level, const String& msg) {
+    publishAlert(level, msg.c_str());
+}
+
+// ===== Command Frames ===== //
+
+// Wall-clock time in microseconds since the epoch, comparable with the sender's send time
+uint64_t wallClockUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+// Records the break-before-make gap of a command output reversal
+void recordInterlockGap(uint32_t gapUs) {
+    portENTER_CRITICAL(&commandStatsMux);
+    interlockStats.record(gapUs);
+    portEXIT_CRITICAL(&commandStatsMux);
+}
+
+// Drives the command outputs for one opcode. Only pin writes happen here so the relay edge
+// can be timestamped right after; logging is left to the caller. Returns false for an
+// unsupported opcode.
+bool executeCommand(uint8_t opcode) {
+    uint32_t gapUs;
+    if (commandRelays.execute(opcode, gapUs)) {
+        if (gapUs) recordInterlockGap(gapUs);
+        return true;
+    }
+    switch (opcode) {
+        case CMD_OP_BRAKE:
+            digitalWrite(BRAKE_PIN, HIGH);
+            return true;
+        case CMD_OP_RELEASE_BRAKE:
+            digitalWrite(BRAKE_PIN, LOW);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Receivers: posts a binary command frame to commandTask. Returns false if data is not a
+// command frame. Never blocks; a full queue drops the frame and counts it.
+bool postCommandFrame(const uint8_t* data, int len, CommandTransport transport, const uint8_t* mac) {
+    if (!cmd_frame_valid(data, len)) return false;
+    QueuedCommand command = {};
+    memcpy(&command.frame, data, sizeof(command.frame));
+    if (command.frame.opcode == CMD_OP_ACK) return false;
+    command.transport = (uint8_t)transport;
+    command.framed = true;
+    if (mac) memcpy(command.mac, mac, ESP_NOW_ETH_ALEN);
+    command.receivedUs = micros();
+    if (xQueueSend(commandQueue, &command, 0) != pdTRUE) commandQueueDrops++;
+    return true;
+}
+
+// LED interlocks: releases the command outputs that the interlock covers. commandTask owns
+// them, so the stop goes to the front of its queue; the task preempts loop() and runs it
+// before any queued command. Nothing is posted while the outputs are already off.
+void releaseCommandOutputs(uint8_t interlock) {
+    uint8_t opcode = commandRelays.releaseOpcode(interlock);
+    if (!opcode) return;
+    QueuedCommand command = {};
+    command.frame.opcode = opcode;
+    command.interlock = true;
+    command.receivedUs = micros();
+    if (xQueueSendToFront(commandQueue, &command, pdMS_TO_TICKS(COMMAND_INTERLOCK_WAIT_MS)) != pdTRUE) {
+        commandQueueDrops++;  // The alarm refresh tries again
+    }
+}
+
+// commandTask: sequence-checks and executes one binary command frame, records its latency
+// and fills in the ack. handled_us includes the time spent in commandQueue.
+void handleCommandFrame(const command_frame_t& frame, CommandTransport transport, uint32_t receivedUs,
+                        command_frame_t& ack) {
+    portENTER_CRITICAL(&commandStatsMux);
+    SequenceCheck check = commandSequencer.check(frame.sender_id, frame.sequence);
+    portEXIT_CRITICAL(&commandStatsMux);
+
+    uint8_t status = CMD_STATUS_OK;
+    if (check == SequenceCheck::Duplicate) status = CMD_STATUS_DUPLICATE;
+    else if (check == SequenceCheck::Stale) status = CMD_STATUS_STALE;
+    else if (!executeCommand(frame.opcode)) status = CMD_STATUS_UNKNOWN;
+    uint64_t edgeUs = wallClockUs();
+    uint32_t handledUs = micros() - receivedUs;
+
+    uint8_t t = (uint8_t)transport;
+    portENTER_CRITICAL(&commandStatsMux);
+    commandStats[t].frames++;
+    if (status == CMD_STATUS_OK) {
+        commandStats[t].executed++;
+        if (edgeUs >= frame.sent_us && edgeUs - frame.sent_us <= COMMAND_LATENCY_MAX_US) {
+            commandLatency[t].record((uint32_t)(edgeUs - frame.sent_us));
+        } else {
+            commandStats[t].clockSkew++;
+        }
+    } else if (status == CMD_STATUS_DUPLICATE) {
+        commandStats[t].duplicates++;
+    } else if (status == CMD_STATUS_STALE) {
+        commandStats[t].stale++;
+    } else {
+        commandStats[t].unknown++;
+    }
+    portEXIT_CRITICAL(&commandStatsMux);
+
+    cmd_frame_make_ack(&ack, &frame, status, handledUs);
+}
+
+// Called after the ack is on its way, so none of this delays the relay or the ack
+void logCommandFrame(const command_frame_t& frame, const command_frame_t& ack, CommandTransport transport) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Command %s via %s #%lu: %s in %lu us",
+             cmd_opcode_name(frame.opcode), commandTransportName(transport),
+             (unsigned long)frame.sequence, cmd_status_name(ack.status), (unsigned long)ack.handled_us);
+    Serial.println(msg);
+    recordEvent(EventType::Command, msg, false);
+    if (ack.status == CMD_STATUS_OK) {
+        snprintf(msg, sizeof(msg), "Command executed: %s (%s #%lu)", cmd_opcode_name(frame.opcode),
+                 commandTransportName(transport), (unsigned long)frame.sequence);
+        publishCommandLog(msg);
+    }
+}
+
+void queueCommandAck(const command_frame_t& ack) {
+    if (!takeOutboxLock()) return;
+    mqttOutbox.enqueue(mqttOutbox.nextSequence(), OutboxPriority::Command, TOPIC_CMD_ACK, false,
+                       (const char*)&ack, sizeof(ack));
+    xSemaphoreGive(outboxMutex);
+}
+
+void sendEspNowAck(const uint8_t* mac, const command_frame_t& ack) {
+    if (!esp_now_is_peer_exist(mac)) {
+        esp_now_peer_info_t peer = {};
+        memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+        peer.channel = 0;  // Current WiFi channel
+        peer.ifidx = WIFI_IF_STA;
+        peer.encrypt = false;
+        if (esp_now_add_peer(&peer) != ESP_OK) return;
+    }
+    esp_now_send(mac, (const uint8_t*)&ack, sizeof(ack));
+}
+
+// Executes queued commands one at a time: execute first, ack, then log
+void commandTask(void* parameter) {
+    QueuedCommand command;
+    for (;;) {
+        if (xQueueReceive(commandQueue, &command, portMAX_DELAY) != pdTRUE) continue;
+        CommandTransport transport = (CommandTransport)command.transport;
+
+        if (command.interlock) {
+            executeCommand(command.frame.opcode);
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Interlock: %s on the command outputs", cmd_opcode_name(command.frame.opcode));
+            Serial.println(msg);
+            recordEvent(EventType::Log, msg, false);
+            continue;
+        }
+
+        if (!command.framed) {
+            executeCommand(command.frame.opcode);
+            Serial.print("\n=== MQTT Command Received ===\n");
+            Serial.print("Command: ");
+            Serial.println(cmd_opcode_name(command.frame.opcode));
+            Serial.print("UP_OUTPUT_PIN: ");
+            Serial.print(commandRelays.upActive() ? "HIGH" : "LOW");
+            Serial.print(", DOWN_OUTPUT_PIN: ");
+            Serial.println(commandRelays.downActive() ? "HIGH" : "LOW");
+            Serial.println("===========================\n");
+            continue;
+        }
+
+        command_frame_t ack;
+        handleCommandFrame(command.frame, transport, command.receivedUs, ack);
+        if (transport == CommandTransport::EspNow) sendEspNowAck(command.mac, ack);
+        else queueCommandAck(ack);
+        logCommandFrame(command.frame, ack, transport);
+    }
+}
+
+// Publishes one metrics message per transport that received frames since the last call and
+// starts a new window. Latency runs from the sender's clock to ours; both are SNTP-synced,
+// so absolute values include the sync error between the two boards.
+void publishCommandMetrics() {
+    static LatencyHistogram window[CMD_TRANSPORT_COUNT];  // Static: keeps ~1.3 KB off the loop stack
+    CommandTransportStats stats[CMD_TRANSPORT_COUNT];
+
+    portENTER_CRITICAL(&commandStatsMux);
+    for (uint8_t t = 0; t < CMD_TRANSPORT_COUNT; t++) {
+        window[t] = commandLatency[t];
+        commandLatency[t].reset();
+        stats[t] = commandStats[t];
+        commandStats[t] = {};
+    }
+    portEXIT_CRITICAL(&commandStatsMux);
+
+    char timestamp[TIMESTAMP_SIZE];
+    formatTimestamp(timestamp, sizeof(timestamp));
+    for (uint8_t t = 0; t < CMD_TRANSPORT_COUNT; t++) {
+        if (stats[t].frames == 0) continue;
+        const LatencyHistogram& latency = window[t];
+
+        if (!takeOutboxLock()) return;
+        uint32_t seq = mqttOutbox.nextSequence();
+        mqttPayload.begin();
+        mqttPayload.addUnsigned("boot", bootId);
+        mqttPayload.addUnsigned("seq", seq);
+        mqttPayload.add("type", "command_metrics");
+        mqttPayload.add("transport", commandTransportName((CommandTransport)t));
+        mqttPayload.addUnsigned("window_s", COMMAND_METRICS_INTERVAL / 1000);
+        mqttPayload.addUnsigned("frames", stats[t].frames);
+        mqttPayload.addUnsigned("executed", stats[t].executed);
+        mqttPayload.addUnsigned("duplicates", stats[t].duplicates);
+        mqttPayload.addUnsigned("stale", stats[t].stale);
+        mqttPayload.addUnsigned("unknown", stats[t].unknown);
+        mqttPayload.addUnsigned("clock_skew", stats[t].clockSkew);
+        mqttPayload.addUnsigned("samples", latency.count());
+        mqttPayload.addUnsigned("p50_us", latency.percentile(50));
+        mqttPayload.addUnsigned("p99_us", latency.percentile(99));
+        mqttPayload.addUnsigned("max_us", latency.max());
+        mqttPayload.addUnsigned("mean_us", latency.mean());
+        mqttPayload.add("timestamp", timestamp);
+        mqttPayload.finish();
+        mqttOutbox.enqueue(seq, OutboxPriority::Info, TOPIC_METRICS, false, mqttPayload.c_str(), mqttPayload.length());
+        xSemaphoreGive(outboxMutex);
+    }
+}
+
+// Loop time and relay interlock gaps for the last window
+void publishLoopMetrics() {
+    static LatencyHistogram window;  // Static: keeps ~0.7 KB off the loop stack
+    portENTER_CRITICAL(&loopStatsMux);
+    window = loopStats.histogram();
+    loopStats.resetHistogram();
+    uint32_t iterationsPerSecond = loopStats.iterationsPerSecond();
+    portEXIT_CRITICAL(&loopStatsMux);
+    portENTER_CRITICAL(&commandStatsMux);
+    InterlockStats interlock = interlockStats;
+    portEXIT_CRITICAL(&commandStatsMux);
+
+    char timestamp[TIMESTAMP_SIZE];
+    formatTimestamp(timestamp, sizeof(timestamp));
+    if (!takeOutboxLock()) return;
+    uint32_t seq = mqttOutbox.nextSequence();
+    mqttPayload.begin();
+    mqttPayload.addUnsigned("boot", bootId);
+    mqttPayload.addUnsigned("seq", seq);
+    mqttPayload.add("type", "loop_metrics");
+    mqttPayload.addUnsigned("window_s", COMMAND_METRICS_INTERVAL / 1000);
+    mqttPayload.addUnsigned("iterations_per_s", iterationsPerSecond);
+    mqttPayload.addUnsigned("p50_us", window.percentile(50));
+    mqttPayload.addUnsigned("p99_us", window.percentile(99));
+    mqttPayload.addUnsigned("max_us", window.max());
+    mqttPayload.addUnsigned("mean_us", window.mean());
+    mqttPayload.addUnsigned("reversals", interlock.reversals);
+    mqttPayload.addUnsigned("min_gap_us", interlock.minGapUs);
+    mqttPayload.addUnsigned("max_gap_us", interlock.maxGapUs);
+    mqttPayload.addUnsigned("command_queue_drops", commandQueueDrops.load());
+    mqttPayload.addUnsigned("min_free_heap", esp_get_minimum_free_heap_size());
+    mqttPayload.add("timestamp", timestamp);
+    mqttPayload.finish();
+    mqttOutbox.enqueue(seq, OutboxPriority::Info, TOPIC_LOOP_METRICS, false, mqttPayload.c_str(), mqttPayload.length());
+    xSemaphoreGive(outboxMutex);
+}
+
 // MQTT callback function
 void callback(char* topic, byte* payload, unsigned int length) {
+    // Binary command frames: commandTask executes, acks and logs them
+    if (strcmp(topic, unitFrameTopic) == 0 || (acceptBroadcastCommands && strcmp(topic, CMD_FRAME_TOPIC) == 0)) {
+        postCommandFrame(payload, length, CommandTransport::Mqtt, nullptr);
+        return;
+    }
+    if (!acceptBroadcastCommands) return;
+
     // Create a null-terminated string from payload
     char message[length + 1];
     memcpy(message, payload, length);
@@ -351,93 +714,164 @@ void callback(char* topic, byte* payload, unsigned int length) {
     const char* msg = doc["message"];
     const char* timestamp = doc["timestamp"];
 
-    // Only process command messages
+    // Only process command messages (legacy JSON commands, before the dashboard sent frames)
     if (type && strcmp(type, "command") == 0 && msg && timestamp) {
-        Serial.print("\n=== MQTT Command Received ===\n");
-        Serial.print("Command: ");
-        Serial.println(msg);
-        Serial.print("Time: ");
-        Serial.println(timestamp);
-
-        // Command Output Pin Control with debug info
-        if (strcmp(msg, "COMMAND:UP") == 0) {
-            // Safety: First turn off DOWN
-            digitalWrite(DOWN_OUTPUT_PIN, LOW);
-            delay(10);  // Small delay for safety
-            
-            // Then activate UP
-            digitalWrite(UP_OUTPUT_PIN, HIGH);
-            
-            // Debug output
-            Serial.println("Setting UP_OUTPUT_PIN HIGH (3.3V)");
-            Serial.print("UP_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(UP_OUTPUT_PIN));
-            Serial.print("DOWN_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(DOWN_OUTPUT_PIN));
-        } 
-        else if (strcmp(msg, "COMMAND:DOWN") == 0) {
-            // Safety: First turn off UP
-            digitalWrite(UP_OUTPUT_PIN, LOW);
-            delay(10);  // Small delay for safety
-            
-            // Then activate DOWN
-            digitalWrite(DOWN_OUTPUT_PIN, HIGH);
-            
-            // Debug output
-            Serial.println("Setting DOWN_OUTPUT_PIN HIGH (3.3V)");
-            Serial.print("DOWN_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(DOWN_OUTPUT_PIN));
-            Serial.print("UP_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(UP_OUTPUT_PIN));
-        }
-        else if (strcmp(msg, "COMMAND:STOP") == 0) {
-            // Turn off both outputs
-            digitalWrite(UP_OUTPUT_PIN, LOW);
-            digitalWrite(DOWN_OUTPUT_PIN, LOW);
-            
-            // Debug output
-            Serial.println("Setting both output pins LOW (0V)");
-            Serial.print("UP_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(UP_OUTPUT_PIN));
-            Serial.print("DOWN_OUTPUT_PIN state: ");
-            Serial.println(digitalRead(DOWN_OUTPUT_PIN));
-        }
-        Serial.println("===========================\n");
+        QueuedCommand command = {};
+        if (strcmp(msg, "COMMAND:UP") == 0) command.frame.opcode = CMD_OP_UP;
+        else if (strcmp(msg, "COMMAND:DOWN") == 0) command.frame.opcode = CMD_OP_DOWN;
+        else if (strcmp(msg, "COMMAND:STOP") == 0) command.frame.opcode = CMD_OP_STOP;
+        if (!command.frame.opcode) return;
+        command.transport = (uint8_t)CommandTransport::Mqtt;
+        command.receivedUs = micros();
+        if (xQueueSend(commandQueue, &command, 0) != pdTRUE) commandQueueDrops++;
     }
 }
 
-// Function to reconnect to MQTT broker
-void reconnectMQTT() {
-    if (WiFi.status() != WL_CONNECTED) {
-        return;
+// Unit id and per-unit topics; before the MQTT task starts, read-only afterwards
+void setupUnitTopics() {
+    if (unitName[0]) {
+        strlcpy(unitId, unitName, sizeof(unitId));
+    } else {
+        uint64_t mac = ESP.getEfuseMac();  // Byte 0 of the MAC in the low byte
+        snprintf(unitId, sizeof(unitId), "lift-%02x%02x%02x", (unsigned)(mac >> 24) & 0xff,
+                 (unsigned)(mac >> 32) & 0xff, (unsigned)(mac >> 40) & 0xff);
+    }
+    for (uint8_t i = 0; i < OUTBOX_TOPIC_COUNT; i++) {
+        fleet_unit_topic(unitTopics[i], sizeof(unitTopics[i]), unitId, outboxTopics[i]);
+    }
+    fleet_unit_topic(unitFrameTopic, sizeof(unitFrameTopic), unitId, CMD_FRAME_TOPIC);
+    fleet_unit_topic(unitEspNowTopic, sizeof(unitEspNowTopic), unitId, CMD_ESPNOW_TOPIC);
+    Serial.print("Fleet unit: ");
+    Serial.println(unitId);
+}
+
+// Single connection attempt to the MQTT broker; called from the MQTT task only
+bool connectMQTT() {
+    String clientId = String(unitId) + "-" + String(random(0xffff), HEX);  // Unique per unit
+    if (!mqttClient.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
+        Serial.print("MQTT connection failed, state ");
+        Serial.println(mqttClient.state());
+        return false;
+    }
+    Serial.println("Connected to MQTT broker");
+
+    // Subscribe to topics
+    mqttClient.subscribe(unitFrameTopic, 1);
+    String subscribeMsg = "Subscribed to topics: " + String(unitFrameTopic);
+    if (acceptBroadcastCommands) {
+        mqttClient.subscribe(commandLogTopic);
+        mqttClient.subscribe(generalLogTopic);
+        mqttClient.subscribe(alertLogTopic);
+        mqttClient.subscribe(CMD_FRAME_TOPIC, 1);
+        subscribeMsg += ", " + String(commandLogTopic) + ", " + String(generalLogTopic) + ", " +
+                        String(alertLogTopic) + ", " + String(CMD_FRAME_TOPIC);
     }
-    int attempts = 0;
-    const int MAX_ATTEMPTS = 3;
-    while (!mqttClient.connected() && attempts < MAX_ATTEMPTS) {
-        String clientId = "ESP32Client-" + String(random(0xffff), HEX);
-        if (mqttClient.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
-            Serial.println("Connected to MQTT broker");
-            
-            // Subscribe to topics
-            mqttClient.subscribe(commandLogTopic);
-            mqttClient.subscribe(generalLogTopic);
-            mqttClient.subscribe(alertLogTopic);
-            
-            // Send subscription confirmation to both topics
-            String subscribeMsg = "Subscribed to topics: " + String(commandLogTopic) + ", " + String(generalLogTopic) + ", " + String(alertLogTopic);
-            publishGeneralLog(subscribeMsg, "info");
-            
-            // Send connection message
-            publishGeneralLog("Device connected and ready", "info");
-            return;
+    publishGeneralLog(subscribeMsg, "info");
+
+#if CMD_FRAME_ESPNOW
+    // Where HMIs send ESP-NOW frames; retained so an HMI that connects later still finds it
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    WiFi.macAddress(mac);
+    mqttClient.publish(unitEspNowTopic, mac, sizeof(mac), true);
+#endif
+
+    // Send connection message
+    publishGeneralLog("Device connected and ready", "info");
+    return true;
+}
+
+// Publishes one outbox entry to every topic in its mask, per unit and optionally also on the
+// single-lift topic. Returns false if any publish failed; the entry then stays queued with the
+// topics it did reach marked, and the retry sends only the rest.
+bool publishOutboxEntry(const OutboxEntry& entry) {
+    const char* topics[OUTBOX_TOPIC_COUNT * 2];
+    uint8_t topicCount = 0;
+    for (uint8_t i = 0; i < OUTBOX_TOPIC_COUNT; i++) {
+        if (!(entry.topicMask & (1 << i))) continue;
+        topics[topicCount++] = unitTopics[i];
+        if (publishSingleLiftTopics) topics[topicCount++] = outboxTopics[i];
+    }
+    uint16_t published = entry.published;
+    uint8_t attempted = topicCount - __builtin_popcount(published);
+    uint8_t sent = MQTTPayload::publish(mqttClient, topics, topicCount, entry.payload, entry.length, published);
+    bool complete = published == (uint16_t)((1u << topicCount) - 1);
+    xSemaphoreTake(outboxMutex, portMAX_DELAY);
+    mqttPayload.recordPublishes(sent, attempted - sent);
+    if (!complete) mqttOutbox.markPublished(entry.sequence, published);
+    xSemaphoreGive(outboxMutex);
+    return complete;
+}
+
+// ===== MQTT Connection Task ===== //
+// Owns WiFi recovery and mqttClient: connects with exponential backoff and jitter, runs
+// mqttClient.loop(), drains the outbox in priority order and keeps its journal up to date.
+// Runs on core 0 so a slow TLS handshake or an unreachable broker never stalls loop().
+void mqttTask(void* parameter) {
+    static OutboxEntry entry;  // Copy of the entry being published, sent outside the lock
+    static OutboxJournalBatch journalBatch;  // Journal records written outside the lock
+    unsigned long lastWiFiRetry = millis();
+    unsigned long nextAttempt = 0;
+    unsigned long replayStart = 0;
+    bool replaying = false;
+
+    for (;;) {
+        unsigned long now = millis();
+
+        if (WiFi.status() != WL_CONNECTED) {
+            mqttConnected = false;
+            if (now - lastWiFiRetry >= WIFI_RETRY_INTERVAL) {
+                WiFi.disconnect();
+                WiFi.begin(ssid, password);
+                lastWiFiRetry = now;
+            }
+        } else if (!mqttClient.connected()) {
+            if (mqttConnected) {
+                mqttConnected = false;
+                Serial.println("MQTT connection lost");
+            }
+            if ((long)(now - nextAttempt) >= 0) {
+                if (connectMQTT()) {
+                    mqttConnected = true;
+                    mqttReconnects++;
+                    mqttBackoff.reset();
+                    replaying = true;
+                    replayStart = millis();
+                } else {
+                    nextAttempt = millis() + mqttBackoff.nextDelay(esp_random());
+                }
+            }
+        } else {
+            mqttClient.loop();
+
+            for (uint8_t n = 0; n < MQTT_DRAIN_BATCH; n++) {
+                xSemaphoreTake(outboxMutex, portMAX_DELAY);
+                bool pending = mqttOutbox.peek(entry);
+                xSemaphoreGive(outboxMutex);
+                if (!pending || !publishOutboxEntry(entry)) break;
+
+                xSemaphoreTake(outboxMutex, portMAX_DELAY);
+                mqttOutbox.acknowledge(entry.sequence);
+                xSemaphoreGive(outboxMutex);
+            }
         }
-        attempts++;
-        if (attempts < MAX_ATTEMPTS) {
-            delay(5000);
+
+        xSemaphoreTake(outboxMutex, portMAX_DELAY);
+        if (replaying && mqttConnected && mqttOutbox.empty()) {
+            mqttOutbox.getStats().lastReplayMs = millis() - replayStart;
+            replaying = false;
         }
-    }
-    if (!mqttClient.connected()) {
-        Serial.println("Failed to connect to MQTT after maximum attempts");
+        bool journalPending = mqttOutbox.prepareSync(journalBatch);
+        xSemaphoreGive(outboxMutex);
+
+        if (journalPending) {
+            size_t journalBytes;
+            bool journalOk = MQTTOutbox::writeSync(SPIFFS, journalBatch, journalBytes);
+            xSemaphoreTake(outboxMutex, portMAX_DELAY);
+            mqttOutbox.finishSync(journalBatch, journalOk, journalBytes);
+            xSemaphoreGive(outboxMutex);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(MQTT_TASK_PERIOD_MS));
     }
 }
 
@@ -447,33 +881,39 @@ bool sendAlarmEmail(String alarmType, String alarmMessage) {
         return false;
     }
     
-    // Instead of sending email directly, publish to MQTT for web interface to handle
-    if (mqttClient.connected()) {
-        String payload = "{\"type\":\"email_alert\",\"alert_type\":\"" + alarmType + 
-                        "\",\"message\":\"" + alarmMessage + 
-                        "\",\"timestamp\":\"" + getTimestamp() + "\"}";
-        Serial.println("Publishing email alert to MQTT: " + payload);
-        mqttClient.publish("usf/alerts/email", payload.c_str());
-        lastEmailSent = millis();
-        return true;
-    }
-    Serial.println("Email not sent: MQTT client not connected");
-    return false;
+    // Instead of sending email directly, publish to MQTT for web interface to handle.
+    // Queued and journaled, so it is delivered once the broker is reachable.
+    publishEvent("email_alert", alarmType.c_str(), alarmMessage.c_str(), nullptr, TOPIC_EMAIL,
+                 OutboxPriority::Red, true);
+    Serial.print("Queued email alert for MQTT: ");
+    Serial.println(alarmMessage);
+    lastEmailSent = millis();
+    return true;
 }
 
 // ===== HTML Content ===== //
 
 // Buffer sizes and optimization constants
-const size_t LOG_BUFFER_SIZE = 1024;  // 1KB buffer for logs
-const size_t MAX_LOG_SIZE = 2000;     // Maximum log size before truncation
-const unsigned long LOG_FLUSH_INTERVAL = 5000; // Flush log buffer every 5 seconds
+const size_t MAX_LOG_SIZE = 2000;     // /getStatus "logs" size limit
+const size_t MAX_LED_HISTORY_SIZE = 3000;  // /getStatus "ledStatusHistory" size limit
+const uint32_t STATUS_EVENT_WINDOW_S = 600;  // /getStatus shows events from the last 10 minutes
+const unsigned long LOG_FLUSH_INTERVAL = 5000; // Flush buffered events to SPIFFS every 5 seconds
 const size_t TIME_BUFFER_SIZE = 30;    // Buffer for timestamp strings
-
-// Buffers for string operations
-char timeBuffer[TIME_BUFFER_SIZE];     // Reusable buffer for timestamps
-char logBuffer[LOG_BUFFER_SIZE];       // Buffer for log messages
-size_t logBufferIndex = 0;            // Current position in log buffer
-unsigned long lastLogFlush = 0;        // Last time logs were written to SPIFFS
+const uint16_t EVENT_QUERY_CHUNK = 16;  // Records read per eventStore lock in /events
+const uint32_t EVENT_QUERY_DEFAULT_LIMIT = 500;
+const uint32_t EVENT_QUERY_MAX_LIMIT = 5000;
+
+// recordEvent() only queues; eventsTask appends to eventStore and does all of its SPIFFS
+// writes, so no caller (loop() publishing an alarm, commandTask logging) waits on flash
+struct QueuedEvent {
+    uint32_t timestamp;
+    uint8_t type;          // EventType
+    bool flushNow;
+    char text[EVENT_PAYLOAD_MAX + 1];
+};
+const uint8_t EVENT_QUEUE_LENGTH = 16;
+QueueHandle_t eventQueue = NULL;
+std::atomic<uint32_t> eventQueueDrops{0};  // Events dropped because the queue was full
 
 // Add these constants near the top with other constants
 const unsigned long DEBUG_LOG_INTERVAL = 5000;  // Only log debug messages every 5 seconds
@@ -481,497 +921,551 @@ const unsigned long LED_STATUS_LOG_INTERVAL = 10000;  // Only log LED status eve
 unsigned long lastDebugLog = 0;
 unsigned long lastLEDStatusLog = 0;
 
-// Optimized addToLog function
+// Log lines are written to SPIFFS by eventsTask every LOG_FLUSH_INTERVAL
 void addToLog(const String &message) {
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-        strftime(timeBuffer, TIME_BUFFER_SIZE, "[%Y-%m-%d %H:%M:%S] ", &timeinfo);
-    } else {
-        strcpy(timeBuffer, "[time error] ");
-    }
-
-    // Calculate total length needed
-    size_t messageLen = strlen(timeBuffer) + message.length() + 2; // +2 for \n and null terminator
-
-    // If buffer would overflow, flush it first
-    if (logBufferIndex + messageLen >= LOG_BUFFER_SIZE) {
-        flushLogBuffer();
-    }
+    Serial.println(message);
+    recordEvent(EventType::Log, message.c_str(), false);
+}
 
-    // Add to buffer
-    strcpy(logBuffer + logBufferIndex, timeBuffer);
-    logBufferIndex += strlen(timeBuffer);
-    message.toCharArray(logBuffer + logBufferIndex, LOG_BUFFER_SIZE - logBufferIndex);
-    logBufferIndex += message.length();
-    logBuffer[logBufferIndex++] = '\n';
-    logBuffer[logBufferIndex] = '\0';
+// Queues one event stamped with the wall clock; alarms pass flushNow so eventsTask writes
+// them to flash right away instead of with the next periodic flush. Never blocks.
+void recordEvent(EventType type, const char* text, bool flushNow) {
+    if (!eventQueue) return;
+    QueuedEvent event;
+    event.timestamp = (uint32_t)time(nullptr);
+    event.type = (uint8_t)type;
+    event.flushNow = flushNow;
+    strlcpy(event.text, text, sizeof(event.text));
+    if (xQueueSend(eventQueue, &event, 0) != pdTRUE) eventQueueDrops++;
+}
 
-    // Also send to Serial immediately
-    Serial.println(message);
+void eventsTask(void* parameter) {
+    static QueuedEvent event;
+    unsigned long lastFlush = millis();
+    for (;;) {
+        bool received = xQueueReceive(eventQueue, &event, pdMS_TO_TICKS(LOG_FLUSH_INTERVAL)) == pdTRUE;
+        xSemaphoreTake(eventStoreMutex, portMAX_DELAY);
+        if (received) eventStore.append(SPIFFS, (EventType)event.type, event.timestamp, event.text, strlen(event.text));
+        if ((received && event.flushNow) || millis() - lastFlush >= LOG_FLUSH_INTERVAL) {
+            eventStore.flush(SPIFFS);
+            lastFlush = millis();
+        }
+        uint32_t sequence = eventStore.lastSequence();
+        xSemaphoreGive(eventStoreMutex);
 
-    // Check if it's time to flush the buffer
-    if (millis() - lastLogFlush >= LOG_FLUSH_INTERVAL) {
-        flushLogBuffer();
+        if (!received) continue;
+        xSemaphoreTake(statusMutex, portMAX_DELAY);
+        statusModel.setEventSequence(sequence);
+        xSemaphoreGive(statusMutex);
     }
 }
 
-// New function to flush log buffer
-void flushLogBuffer() {
-    if (logBufferIndex == 0) return;  // Nothing to flush
+// ===== Web status: delta polling and Server-Sent Events ===== //
+// The web server runs on its own task. Responses are rendered from a StatusModel copy
+// through JsonChunkWriter, so a poll costs one lock and a few hundred bytes of stack
+// instead of a heap String of the whole state.
+const uint8_t SSE_MAX_CLIENTS = 4;
+const unsigned long STATUS_PUSH_PERIOD_MS = 100;  // Changes within this window go out as one event
+const unsigned long SSE_HEARTBEAT_MS = 15000;     // Comment line that keeps idle streams open
+const unsigned long WEB_TASK_PERIOD_MS = 2;
+
+// Bits for writeStatus() beyond the StatusModel sections
+#define STATUS_WITH_STATS   0x100  // MQTT, outbox, LED capture and event store counters
+#define STATUS_WITH_HISTORY 0x200  // Recent log lines and LED history (/getStatus)
+
+WiFiClient sseClients[SSE_MAX_CLIENTS];  // Open /stream connections, web task only
+int sseTarget = -1;                      // Client sendSseChunk() writes to, -1 for all
+uint32_t ssePushedSeq = 0;               // Status sequence the streams have been sent
+unsigned long lastStatusPush = 0;
+unsigned long lastSseWrite = 0;
+
+struct EventCopy {
+  EventRecordHeader header;
+  char text[EVENT_PAYLOAD_MAX + 1];
+};
+EventCopy eventBatch[EVENT_QUERY_CHUNK];  // Records copied out under the lock, web task only
 
-    // Append to serialLogs with size limit
-    if (serialLogs.length() + logBufferIndex > MAX_LOG_SIZE) {
-        serialLogs = serialLogs.substring(serialLogs.length() - (MAX_LOG_SIZE - logBufferIndex));
-    }
-    serialLogs += String(logBuffer);
+// Where a chunk of recent events starts, so writeEventText() can read it again
+struct EventChunkMark {
+  EventCursor cursor;
+  uint16_t count;
+  uint32_t bytes;  // Rendered line bytes
+};
+const uint8_t EVENT_TEXT_MARKS = 32;  // Newest chunks remembered; more than the size limits need
+const size_t EVENT_LINE_PREFIX = 22;  // "[YYYY-mm-dd HH:MM:SS] "
+EventChunkMark eventTextMarks[EVENT_TEXT_MARKS];  // Web task only
+
+// Up to maxRecords matching records into eventBatch, copied under the eventStore lock
+uint16_t readEventBatch(const EventQuery& query, EventCursor& cursor, uint16_t maxRecords) {
+    uint16_t count = 0;
+    xSemaphoreTake(eventStoreMutex, portMAX_DELAY);
+    eventStore.readChunk(SPIFFS, query, cursor, maxRecords, [&](const EventRecordHeader& header, const char* payload) {
+        eventBatch[count].header = header;
+        strlcpy(eventBatch[count].text, payload, sizeof(eventBatch[count].text));
+        count++;
+    });
+    xSemaphoreGive(eventStoreMutex);
+    return count;
+}
 
-    // Reset buffer
-    logBufferIndex = 0;
-    lastLogFlush = millis();
+size_t eventLineBytes(const char* text) {
+    return EVENT_LINE_PREFIX + strlen(text) + 1;
 }
 
-// Optimized LED reading function
-void readDeviceOutputs() {
-    unsigned long currentMillis = millis();
-    static String tempStatus;
-    tempStatus.reserve(500);
-    
-    if (currentMillis - previousMillis >= LED_CHECK_DELAY) {
-        tempStatus = "";
-        bool significantChange = false;
+void writeEventLine(JsonChunkWriter& json, uint32_t timestamp, const char* text) {
+    char timeBuffer[TIME_BUFFER_SIZE];
+    time_t stamp = timestamp;
+    struct tm timeinfo;
+    localtime_r(&stamp, &timeinfo);
+    strftime(timeBuffer, sizeof(timeBuffer), "[%Y-%m-%d %H:%M:%S] ", &timeinfo);
+    json.stringPart(timeBuffer);
+    json.stringPart(text);
+    json.stringPart("\n");
+}
 
-        // Read LED states and check for changes
-        for (int i = 0; i < numLEDs; i++) {
-            bool prevRedState = redLEDStates[i].currentState;
-            bool prevGreenState = greenLEDStates[i].currentState;
-            
-            redLEDStates[i].currentState = digitalRead(redLEDs[i]);
-            greenLEDStates[i].currentState = digitalRead(greenLEDs[i]);
-
-            if (redLEDStates[i].currentState != prevRedState || 
-                greenLEDStates[i].currentState != prevGreenState) {
-                significantChange = true;
-            }
+// "[YYYY-mm-dd HH:MM:SS] text" lines for the event types in typeMask from the last
+// STATUS_EVENT_WINDOW_S seconds, written as one JSON string; oldest lines are dropped
+// past maxChars. The first pass only measures chunks and remembers where the newest ones
+// start; the second reads those again and streams the lines that fit, so nothing is
+// collected on the heap.
+void writeEventText(JsonChunkWriter& json, uint32_t typeMask, size_t maxChars, bool newestFirst) {
+    json.beginString();
+    if (!eventStoreMutex) {
+        json.endString();
+        return;
+    }
+    uint32_t now = (uint32_t)time(nullptr);
+    EventQuery query = {now > STATUS_EVENT_WINDOW_S ? now - STATUS_EVENT_WINDOW_S : 0, UINT32_MAX, typeMask, 0};
+    EventCursor cursor = {};
+    uint32_t markCount = 0;
+    while (!cursor.done) {
+        EventChunkMark mark = {cursor, 0, 0};
+        mark.count = readEventBatch(query, cursor, EVENT_QUERY_CHUNK);
+        if (mark.count == 0) continue;
+        for (uint16_t i = 0; i < mark.count; i++) mark.bytes += eventLineBytes(eventBatch[i].text);
+        eventTextMarks[markCount++ % EVENT_TEXT_MARKS] = mark;
+    }
 
-            if (redLEDStates[i].currentState != redLEDStates[i].lastState) {
-                redLEDStates[i].changeCount++;
-                redLEDStates[i].lastState = redLEDStates[i].currentState;
-            }
+    // Newest chunks that cover maxChars
+    uint32_t first = markCount;
+    size_t bytes = 0;
+    while (first > 0 && markCount - first < EVENT_TEXT_MARKS && bytes < maxChars) {
+        bytes += eventTextMarks[--first % EVENT_TEXT_MARKS].bytes;
+    }
 
-            if (greenLEDStates[i].currentState != greenLEDStates[i].lastState) {
-                greenLEDStates[i].changeCount++;
-                greenLEDStates[i].lastState = greenLEDStates[i].currentState;
+    if (newestFirst) {
+        size_t written = 0;
+        for (uint32_t m = markCount; m > first; m--) {
+            EventChunkMark mark = eventTextMarks[(m - 1) % EVENT_TEXT_MARKS];
+            uint16_t count = readEventBatch(query, mark.cursor, mark.count);
+            for (int i = count - 1; i >= 0; i--) {
+                written += eventLineBytes(eventBatch[i].text);
+                if (written > maxChars) break;
+                writeEventLine(json, eventBatch[i].header.timestamp, eventBatch[i].text);
             }
+            if (written > maxChars) break;
         }
-
-        // Only log if there's a significant change and enough time has passed
-        if (significantChange && (currentMillis - lastLEDStatusLog >= LED_STATUS_LOG_INTERVAL)) {
-            String debugMsg = "LED States - Red: ";
-            for (int i = 0; i < numLEDs; i++) {
-                int redState = (redLEDStates[i].changeCount >= 2) ? 2 : redLEDStates[i].currentState ? 1 : 0;
-                debugMsg += String(redState) + " ";
-            }
-            debugMsg += "| Green: ";
-            for (int i = 0; i < numLEDs; i++) {
-                int greenState = (greenLEDStates[i].changeCount >= 2) ? 2 : greenLEDStates[i].currentState ? 1 : 0;
-                debugMsg += String(greenState) + " ";
-            }
-            publishGeneralLog(debugMsg, "info");
-            lastLEDStatusLog = currentMillis;
-            
-            // Reset change counters after logging
-            for (int i = 0; i < numLEDs; i++) {
-                redLEDStates[i].changeCount = 0;
-                greenLEDStates[i].changeCount = 0;
+    } else {
+        for (uint32_t m = first; m < markCount; m++) {
+            EventChunkMark mark = eventTextMarks[m % EVENT_TEXT_MARKS];
+            uint16_t count = readEventBatch(query, mark.cursor, mark.count);
+            for (uint16_t i = 0; i < count; i++) {
+                if (bytes > maxChars) {
+                    bytes -= eventLineBytes(eventBatch[i].text);
+                    continue;
+                }
+                writeEventLine(json, eventBatch[i].header.timestamp, eventBatch[i].text);
             }
         }
+    }
+    json.endString();
+}
 
-        // Build status string for display
-        for (int i = 0; i < numLEDs; i++) {
-            tempStatus += "Red LED " + String(i) + ": ";
-            if (redLEDStates[i].changeCount >= 2) {
-                tempStatus += "FLASHING";
-            } else {
-                tempStatus += (redLEDStates[i].currentState ? "ON" : "OFF");
-            }
-            tempStatus += "\n";
-            
-            tempStatus += "Green LED " + String(i) + ": ";
-            if (greenLEDStates[i].changeCount >= 2) {
-                tempStatus += "FLASHING";
-            } else {
-                tempStatus += (greenLEDStates[i].currentState ? "ON" : "OFF");
-            }
-            tempStatus += "\n";
-        }
+void touchStatus(StatusSection section) {
+    xSemaphoreTake(statusMutex, portMAX_DELAY);
+    statusModel.touch(section);
+    xSemaphoreGive(statusMutex);
+}
 
-        // Only process alarms if there were changes
-        if (significantChange) {
-            processLEDStatus(tempStatus, currentMillis);
-        }
+StatusModel snapshotStatus() {
+    xSemaphoreTake(statusMutex, portMAX_DELAY);
+    StatusModel snapshot = statusModel;
+    xSemaphoreGive(statusMutex);
+    return snapshot;
+}
 
-        previousMillis = currentMillis;
+void sendHttpChunk(const char* data, size_t length) {
+    server.sendContent(data, length);
+}
+
+void sendSseChunk(const char* data, size_t length) {
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        if ((sseTarget >= 0 && i != sseTarget) || !sseClients[i]) continue;
+        if (sseClients[i].write((const uint8_t*)data, length) != length) sseClients[i].stop();
     }
+    lastSseWrite = millis();
 }
 
-// New function to process LED status
-void processLEDStatus(const String& tempStatus, unsigned long currentMillis) {
-    static String lastRedAlarms = "";
-    static String lastAmberAlarms = "";
-    static String lastGreenAlarms = "";
-    static unsigned long lastAlertTime = 0;
-
-    // Create LED state string
-    String ledStateMsg = "LED States - [";
-    // Add Red LEDs
-    for (int i = 0; i < numLEDs; i++) {
-        int redState = (redLEDStates[i].changeCount >= 2) ? 2 : redLEDStates[i].currentState ? 1 : 0;
-        ledStateMsg += String(redState);
-        if (i < numLEDs - 1) ledStateMsg += ",";
+void writeStatus(JsonChunkWriter& json, const StatusModel& snapshot, uint32_t sections) {
+    const StatusState& state = snapshot.get();
+    json.beginObject();
+    char boot[STATUS_BOOT_ID_SIZE];
+    formatBootId(boot, sizeof(boot), bootId);
+    json.key("boot");
+    json.string(boot);
+    json.key("unit");
+    json.string(unitId);
+    json.key("seq");
+    json.number(snapshot.sequence());
+    json.key("full");
+    json.boolean((sections & STATUS_ALL_SECTIONS) == STATUS_ALL_SECTIONS);
+
+    if (sections & STATUS_SECTION_BIT(StatusSection::Mode)) {
+        char delay[12];
+        snprintf(delay, sizeof(delay), "%lu", (unsigned long)state.delayMs);
+        json.key("mode");
+        json.string(state.elevatorMode ? "elevator" : "lift");
+        json.key("delay");
+        json.string(delay);
     }
-    ledStateMsg += "] [";
-    // Add Green LEDs
-    for (int i = 0; i < numLEDs; i++) {
-        int greenState = (greenLEDStates[i].changeCount >= 2) ? 2 : greenLEDStates[i].currentState ? 1 : 0;
-        ledStateMsg += String(greenState);
-        if (i < numLEDs - 1) ledStateMsg += ",";
+    if (sections & STATUS_SECTION_BIT(StatusSection::Leds)) {
+        json.key("ledStatus");
+        json.string(state.ledStatus);
     }
-    ledStateMsg += "]";
-
-    // === Declare shorthand LED state variables ===
-    bool r0 = redLEDStates[0].lastState;
-    bool r1 = redLEDStates[1].lastState;
-    bool r2 = redLEDStates[2].lastState;
-    bool r3 = redLEDStates[3].lastState;
-
-    bool g0 = greenLEDStates[0].lastState;
-    bool g1 = greenLEDStates[1].lastState;
-    bool g2 = greenLEDStates[2].lastState;
-    bool g3 = greenLEDStates[3].lastState;
-
-    // === Detect Flashing Based on State Changes ===
-    bool r0f = redLEDStates[0].changeCount >= 2;
-    bool r1f = redLEDStates[1].changeCount >= 2;
-    bool r2f = redLEDStates[2].changeCount >= 2;
-    bool r3f = redLEDStates[3].changeCount >= 2;
-
-    bool g0f = greenLEDStates[0].changeCount >= 2;
-    bool g1f = greenLEDStates[1].changeCount >= 2;
-    bool g2f = greenLEDStates[2].changeCount >= 2;
-    bool g3f = greenLEDStates[3].changeCount >= 2;
-
-    // === Amber Conditions Per LED ===
-    bool a0 = r0 && g0;
-    bool a1 = r1 && g1;
-    bool a2 = r2 && g2;
-    bool a3 = r3 && g3;
-
-    bool a0f = (r0f && g0f) || (r0f && g0) || (r0 && g0f);
-    bool a1f = (r1f && g1f) || (r1f && g1) || (r1 && g1f);
-    bool a2f = (r2f && g2f) || (r2f && g2) || (r2 && g2f);
-    bool a3f = (r3f && g3f) || (r3f && g3) || (r3 && g3f);
-
-    String currentRedAlarms = "";
-    String currentAmberAlarms = "";
-    String currentGreenAlarms = "";
-
-    // === Mutual Exclusion Logic ===
-    bool anyGreenOn = false;
-    bool anyRedFlashing = false;
-    for (int i = 0; i < numLEDs; i++) {
-        if (greenLEDStates[i].lastState) anyGreenOn = true;
-        if (redLEDStates[i].changeCount >= 2) anyRedFlashing = true;
+    if (sections & STATUS_SECTION_BIT(StatusSection::Alarms)) {
+        json.key("greenAlarms");
+        json.string(state.greenAlarm);
+        json.key("amberAlarms");
+        json.string(state.amberAlarm);
+        json.key("redAlarms");
+        json.string(state.redAlarm);
     }
-    bool anyAmberFlashing = a0f || a1f || a2f || a3f;
-
-    // Build consolidated status message
-    String statusMsg = ledStateMsg;
-    bool hasAlerts = false;
-
-    // RED ALARMS - Only if NO green LED is ON and NO amber is flashing
-    if (!anyGreenOn && !anyAmberFlashing) {
-        String alertName = "";
-        if (!r0 && !r1 && !r2 && !r3) {
-            alertName = "R01"; // All RED LEDs are OFF
-        } else if (r0 && r1 && r2 && r3) {
-            alertName = "R02"; // E-Stop is OFF
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0 && r1 && r2 && !r3) {
-            alertName = "R15"; // OSG/Pit Switch
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0 && r1 && !r2 && !r3) {
-            alertName = "R23"; // Door Lock Failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0 && !r1 && r2 && r3) {
-            alertName = "R22"; // Door Open
-            stopUpMovement();
-            stopDownMovement();
-        }
-        // Flashing LED conditions
-        if (!r0f && !r1f && !r2f && !r3f) {
-            alertName = "R00"; // No FLASHING RED LEDs
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && r1f && !r2f && !r3f) {
-            alertName = "R31"; // Out of Service (flood switch)
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && r1f && r2f && r3f) {
-            alertName = "R36"; // Out of Service – periodic maintenance
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0f && !r1f && !r2f && !r3f) {
-            alertName = "R37"; // Out of Service (travel time)
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && r1f && !r2f && r3f) {
-            alertName = "R07"; // Drive Train, Belt Failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0f && r1f && r2f && r3f) {
-            alertName = "R03"; // Drive Nut Friction block fails
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0f && !r1f && !r2f && r3f) {
-            alertName = "R27"; // Drive Train Alignment
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0f && r1f && r2f && !r3f) {
-            alertName = "R10"; // Final Limit
-            stopUpMovement();
-            stopDownMovement();
-            // Send email for R10 alarm
-            if (alertName != lastRedEmailSent) {
-                sendAlarmEmail("RED", "Final Limit (R10) - Lift has reached final limit switch");
-                lastRedEmailSent = alertName;
-            }
-        } else if (!r0f && !r1f && r2f && !r3f) {
-            alertName = "R11"; // Landing Switch (Top) failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && r1f && r2f && !r3f) {
-            alertName = "R12"; // Landing Switch (Mid) failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (r0f && !r1f && r2f && !r3f) {
-            alertName = "R13"; // Landing Switch (Bottom) failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && !r1f && r2f && r3f) {
-            alertName = "R24"; // Drive Train Motor Failure
-            stopUpMovement();
-            stopDownMovement();
-        } else if (!r0f && !r1f && !r2f && r3f) {
-            alertName = "R05"; // Motor temperature failure
-            stopUpMovement();
-            stopDownMovement();
-        }
-        if (alertName != "") {
-            currentRedAlarms = alertName;
-            statusMsg += " - " + alertName;
-            hasAlerts = true;
-            
-            // Send email for any red alarm if it's different from the last one sent
-            if (alertName != lastRedEmailSent) {
-                String alertDescription = getAlertDescription(alertName);
-                sendAlarmEmail("RED", alertName + " - " + alertDescription);
-                lastRedEmailSent = alertName;
-            }
-        }
+    if (sections & STATUS_SECTION_BIT(StatusSection::Email)) {
+        // The email list is only touched by web handlers, which run on this task
+        json.key("emailEnabled");
+        json.boolean(emailNotificationsEnabled);
+        json.key("emails");
+        json.beginArray();
+        for (int i = 0; i < emailCount; i++) json.string(emailAddresses[i].c_str());
+        json.endArray();
+    }
+    if (sections & STATUS_SECTION_BIT(StatusSection::Events)) {
+        json.key("eventSeq");
+        json.number(state.eventSequence);
     }
 
-    // GREEN ALARMS - Only if NO red LED is flashing
-    if (!anyRedFlashing) {
-        String alertName = "";
-        if (!g0 && !g1 && !g2 && !g3) {
-            alertName = "G01"; // All GREEN LEDs are OFF
-        } else if (g0 && g1 && g2 && g3) {
-            alertName = "G00"; // No exceptions
-        } else if (!g0f && !g1f && !g2f && !g3f) {
-            alertName = "G02"; // No FLASHING GREEN LEDs
-        } else if (g0f && g1f && g2f && !g3f) {
-            alertName = "G03"; // On Battery Power
-        } else if (g0f && g1f && g2f && g3f) {
-            alertName = "G04"; // Bypass Jumpers/Service Switch
-        }
-        if (alertName != "") {
-            currentGreenAlarms = alertName;
-            statusMsg += (hasAlerts ? "/" : " - ") + alertName;
-            hasAlerts = true;
-        }
+    if (sections & STATUS_WITH_HISTORY) {
+        json.key("logs");
+        writeEventText(json, EVENT_TYPE_BIT(EventType::Log), MAX_LOG_SIZE, false);
+        json.key("ledStatusHistory");
+        writeEventText(json, EVENT_TYPE_BIT(EventType::LedStatus), MAX_LED_HISTORY_SIZE, true);
     }
 
-    // AMBER ALARMS (no mutual exclusion)
-    String alertName = "";
-    if (!a0 && !a1 && !a2 && !a3) {
-        alertName = "A01"; // ALL AMBER LEDs OFF
-    } else if (a0 && a1 && a2 && !a3) {
-        alertName = "A04"; // Power Failure
-    } else if (!a0 && a1 && a2 && a3) {
-        alertName = "A39"; // Power Failure
-    } else if (a0 && !a1 && !a2 && !a3) {
-        alertName = "A30"; // Service Required (Flood switch)
-    } else if (!a0 && a1 && !a2 && !a3) {
-        alertName = "A33"; // Service Required – travel time
-    } else if (a0 && a1 && !a2 && !a3) {
-        alertName = "A34"; // Service Required – maintenance
-    } else if (!a0 && !a1 && a2 && !a3) {
-        alertName = "A35"; // Service Required – hours
-    } else if (!a0 && !a1 && a2 && a3) {
-        alertName = "A36"; // Service Required – Battery
-    } else if (a0 && !a1 && !a2 && a3) {
-        alertName = "A37"; // Service Required - Inverter
+    if (sections & STATUS_WITH_STATS) {
+        // Counters owned by other tasks are copied under their locks before any of them is written
+        xSemaphoreTake(outboxMutex, portMAX_DELAY);
+        MQTTPublishStats mqttStats = mqttPayload.getStats();
+        OutboxStats outboxStats = mqttOutbox.getStats();
+        xSemaphoreGive(outboxMutex);
+        portENTER_CRITICAL(&ledCaptureMux);
+        LEDCaptureStats captureStats = ledCaptureStats;
+        portEXIT_CRITICAL(&ledCaptureMux);
+        portENTER_CRITICAL(&loopStatsMux);
+        uint32_t loopRate = loopStats.iterationsPerSecond();
+        uint32_t loopMaxUs = loopStats.histogram().max();
+        portEXIT_CRITICAL(&loopStatsMux);
+
+        json.key("mqttStats");
+        json.beginObject();
+        json.key("events");
+        json.number(mqttStats.events);
+        json.key("bytes");
+        json.number(mqttStats.bytesSerialized);
+        json.key("publishes");
+        json.number(mqttStats.publishes);
+        json.key("failures");
+        json.number(mqttStats.publishFailures);
+        json.key("truncated");
+        json.number(mqttStats.truncated);
+        json.key("peakBuffer");
+        json.number(mqttStats.peakBufferUse);
+        json.endObject();
+
+        json.key("mqttOutbox");
+        json.beginObject();
+        json.key("connected");
+        json.boolean(mqttConnected);
+        json.key("depth");
+        json.number(outboxStats.depth);
+        json.key("peakDepth");
+        json.number(outboxStats.peakDepth);
+        json.key("enqueued");
+        json.number(outboxStats.enqueued);
+        json.key("published");
+        json.number(outboxStats.published);
+        json.key("dropped");
+        json.number(outboxStats.dropped);
+        json.key("replayed");
+        json.number(outboxStats.replayed);
+        json.key("lastReplayMs");
+        json.number(outboxStats.lastReplayMs);
+        json.key("reconnects");
+        json.number(mqttReconnects);
+        json.key("journalWrites");
+        json.number(outboxStats.journalWrites);
+        json.key("lockDrops");
+        json.number(outboxLockDrops.load());
+        json.endObject();
+
+        json.key("ledCapture");
+        json.beginObject();
+        json.key("edges");
+        json.number(captureStats.edges);
+        json.key("dropped");
+        json.number(ledEdgeRing.dropped());
+        json.key("glitches");
+        json.number(captureStats.glitches);
+        json.key("snapshots");
+        json.number(captureStats.snapshots);
+        json.key("lastLatencyMs");
+        json.number(captureStats.lastDetectionLatencyUs / 1000);
+        json.key("maxLatencyMs");
+        json.number(captureStats.maxDetectionLatencyUs / 1000);
+        json.key("lastFlashLatencyMs");
+        json.number(captureStats.lastFlashLatencyUs / 1000);
+        json.key("maxFlashLatencyMs");
+        json.number(captureStats.maxFlashLatencyUs / 1000);
+        json.endObject();
+
+        xSemaphoreTake(eventStoreMutex, portMAX_DELAY);
+        EventStoreStats eventStats = eventStore.getStats();
+        uint32_t oldestEvent = eventStore.oldestTime();
+        xSemaphoreGive(eventStoreMutex);
+        json.key("loop");
+        json.beginObject();
+        json.key("iterationsPerSec");
+        json.number(loopRate);
+        json.key("maxUs");
+        json.number(loopMaxUs);
+        json.key("minFreeHeap");
+        json.number(esp_get_minimum_free_heap_size());
+        json.endObject();
+
+        json.key("eventStore");
+        json.beginObject();
+        json.key("appends");
+        json.number(eventStats.appends);
+        json.key("dropped");
+        json.number(eventStats.dropped);
+        json.key("flushes");
+        json.number(eventStats.flushes);
+        json.key("rotations");
+        json.number(eventStats.rotations);
+        json.key("corrupt");
+        json.number(eventStats.corruptRecords);
+        json.key("segments");
+        json.number(eventStats.segments);
+        json.key("bytes");
+        json.number(eventStats.bytes);
+        json.key("archivedAlarms");
+        json.number(eventStats.archivedAlarms);
+        json.key("queueDrops");
+        json.number(eventQueueDrops.load());
+        json.key("oldest");
+        json.number(oldestEvent);
+        json.endObject();
     }
-    // Flashing amber conditions
-    if (!a0f && !a1f && !a2f && !a3f) {
-        alertName = "A02"; // No FLASHING AMBER LEDs
-    } else if (a0f && a1f && a2f && !a3f) {
-        alertName = "A32"; // Power Failure - UP Locked
-        stopUpMovement();
-    } else if (!a0f && a1f && a2f && a3f) {
-        alertName = "A40"; // Power Failure
-    } else if (!a0f && !a1f && a2f && !a3f) {
-        alertName = "A06"; // Motor Failure - UP Locked
-        stopUpMovement();
-    } else if (a0f && !a1f && !a2f && a3f) {
-        alertName = "A08"; // Anti-Rock binding - UP Locked
-        stopUpMovement();
-    } else if (a0f && a1f && !a2f && !a3f) {
-        alertName = "A14"; // Bottom Final Limit - DOWN Locked
-        stopDownMovement();
-    } else if (!a0f && a1f && !a2f && !a3f) {
-        alertName = "A16"; // Flood waters - DOWN Locked
-        stopDownMovement();
-    } else if (!a0f && a1f && a2f && !a3f) {
-        alertName = "A38"; // Motor Temperature monitoring lost
+    json.endObject();
+}
+
+// One "status" event with the given sections to one stream, or to all with target -1
+void pushStatus(int target, const StatusModel& snapshot, uint32_t sections) {
+    sseTarget = target;
+    JsonChunkWriter json(sendSseChunk);
+    json.raw("event: status\ndata: ");
+    writeStatus(json, snapshot, sections);
+    json.raw("\n\n");
+    json.flush();
+    sseTarget = -1;
+}
+
+void pushStatusUpdates() {
+    unsigned long now = millis();
+    if (now - lastStatusPush < STATUS_PUSH_PERIOD_MS) return;
+    lastStatusPush = now;
+
+    bool streaming = false;
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        if (sseClients[i] && !sseClients[i].connected()) sseClients[i].stop();
+        if (sseClients[i]) streaming = true;
     }
-    if (alertName != "") {
-        currentAmberAlarms = alertName;
-        statusMsg += (hasAlerts ? "/" : " - ") + alertName;
-        hasAlerts = true;
+    if (!streaming) return;
+
+    StatusModel snapshot = snapshotStatus();
+    if (snapshot.sequence() != ssePushedSeq) {
+        pushStatus(-1, snapshot, snapshot.changedSince(ssePushedSeq));
+        ssePushedSeq = snapshot.sequence();
+    } else if (now - lastSseWrite >= SSE_HEARTBEAT_MS) {
+        sendSseChunk(":\n\n", 3);
     }
+}
 
-    // Only print the status message if there are alerts or LED states have changed
-    if (hasAlerts || statusMsg != lastLedSnapshot) {
-        Serial.println(statusMsg);
-        lastLedSnapshot = statusMsg;
+void webServerTask(void* parameter) {
+    for (;;) {
+        server.handleClient();
+        pushStatusUpdates();
+        vTaskDelay(pdMS_TO_TICKS(WEB_TASK_PERIOD_MS));
     }
+}
+
+// LED capture: GPIO edge interrupts feed ledEdgeRing, ledCaptureTask classifies the
+// edges on core 0 and hands debounced snapshots to loop() through ledSnapshotRing.
+// All GPIO ISRs are dispatched from the same interrupt on one core, so the edge ring
+// still has a single producer. The level comes straight from the GPIO input register:
+// digitalRead() is not guaranteed to be in IRAM.
+void IRAM_ATTR onLEDEdge(void* arg) {
+    uint32_t tag = (uint32_t)(uintptr_t)arg;  // (led index << 8) | pin
+    uint32_t pin = tag & 0xFF;
+    uint32_t inputs = REG_READ(pin < 32 ? GPIO_IN_REG : GPIO_IN1_REG);
+    LEDEdge edge = {(uint32_t)micros(), (uint8_t)(tag >> 8), (uint8_t)((inputs >> (pin & 31)) & 1)};
+    ledEdgeRing.push(edge);
+}
 
-    // Process alerts with state management
-    if (shouldPublishAlert(redAlertState, currentRedAlarms, currentMillis)) {
-        String alertDescription = getAlertDescription(currentRedAlarms);
-        publishAlert("red", currentRedAlarms + " - " + alertDescription);
+void ledCaptureTask(void* parameter) {
+    LEDEdge edge;
+    LEDSnapshot snapshot;
+    for (;;) {
+        while (ledEdgeRing.pop(edge)) {
+            ledClassifier.addEdge(edge);
+        }
+        if (ledClassifier.update((uint32_t)micros(), snapshot)) {
+            ledSnapshotRing.push(snapshot);
+        }
+        portENTER_CRITICAL(&ledCaptureMux);
+        ledCaptureStats = ledClassifier.getStats();
+        portEXIT_CRITICAL(&ledCaptureMux);
+        vTaskDelay(pdMS_TO_TICKS(LED_CLASSIFY_PERIOD_MS));
     }
+}
 
-    if (shouldPublishAlert(greenAlertState, currentGreenAlarms, currentMillis)) {
-        String alertDescription = getAlertDescription(currentGreenAlarms);
-        publishAlert("green", currentGreenAlarms + " - " + alertDescription);
+void startLEDCapture() {
+    bool levels[LED_CAPTURE_COUNT];
+    for (int i = 0; i < numLEDs; i++) {
+        levels[i] = digitalRead(redLEDs[i]);
+        levels[numLEDs + i] = digitalRead(greenLEDs[i]);
     }
+    ledClassifier.begin(levels, (uint32_t)micros());
 
-    if (shouldPublishAlert(amberAlertState, currentAmberAlarms, currentMillis)) {
-        String alertDescription = getAlertDescription(currentAmberAlarms);
-        publishAlert("amber", currentAmberAlarms + " - " + alertDescription);
+    for (int i = 0; i < numLEDs; i++) {
+        attachInterruptArg(digitalPinToInterrupt(redLEDs[i]), onLEDEdge,
+                           (void*)(uintptr_t)((i << 8) | redLEDs[i]), CHANGE);
+        attachInterruptArg(digitalPinToInterrupt(greenLEDs[i]), onLEDEdge,
+                           (void*)(uintptr_t)(((numLEDs + i) << 8) | greenLEDs[i]), CHANGE);
     }
 
-    // Update global strings for web interface
-    if (currentRedAlarms != "") redAlarms = currentRedAlarms;
-    if (currentGreenAlarms != "") greenAlarms = currentGreenAlarms;
-    amberAlarms = currentAmberAlarms;
+    // Core 0: keeps classification independent of loop() jitter on core 1
+    xTaskCreatePinnedToCore(ledCaptureTask, "ledCapture", 3072, NULL, 5, NULL, 0);
+}
 
-    // Update LED history
-    if (hasAlerts || statusMsg != lastLedSnapshot) {
-        ledStatus = tempStatus;
-        ledStatusHistory = statusMsg + "\n" + ledStatusHistory;
-        
-        // Trim history to prevent memory issues
-        if (ledStatusHistory.length() > 3000) {
-            ledStatusHistory = ledStatusHistory.substring(0, 3000);
+// Optimized LED reading function: applies snapshots published by the capture task
+void readDeviceOutputs() {
+    unsigned long currentMillis = millis();
+    LEDSnapshot snapshot;
+
+    while (ledSnapshotRing.pop(snapshot)) {
+        for (int i = 0; i < numLEDs; i++) {
+            redLEDStates[i].currentState = (snapshot.word >> (LED_RED_ON_SHIFT + i)) & 1;
+            redLEDStates[i].flashing = (snapshot.word >> (LED_RED_FLASH_SHIFT + i)) & 1;
+            redLEDStates[i].frequencyCentiHz = snapshot.frequencyCentiHz[i];
+            greenLEDStates[i].currentState = (snapshot.word >> (LED_GREEN_ON_SHIFT + i)) & 1;
+            greenLEDStates[i].flashing = (snapshot.word >> (LED_GREEN_FLASH_SHIFT + i)) & 1;
+            greenLEDStates[i].frequencyCentiHz = snapshot.frequencyCentiHz[numLEDs + i];
+        }
+
+        // Only log if enough time has passed
+        if (currentMillis - lastLEDStatusLog >= LED_STATUS_LOG_INTERVAL) {
+            char debugMsg[96];
+            const LEDStateWord w = snapshot.word;
+            snprintf(debugMsg, sizeof(debugMsg), "LED States - Red: %d %d %d %d | Green: %d %d %d %d | Detected in %lu ms",
+                     ledDisplayState(w, false, 0), ledDisplayState(w, false, 1), ledDisplayState(w, false, 2),
+                     ledDisplayState(w, false, 3), ledDisplayState(w, true, 0), ledDisplayState(w, true, 1),
+                     ledDisplayState(w, true, 2), ledDisplayState(w, true, 3),
+                     (unsigned long)(snapshot.detectionLatencyUs / 1000));
+            publishGeneralLog(debugMsg, "info");
+            lastLEDStatusLog = currentMillis;
         }
+
+        // Every snapshot is a change, so interlocks are applied for each one
+        processLEDStatus(snapshot.word, currentMillis);
     }
+
+    // A pattern arrives as one snapshot; keep its interlocks and alerts current while it shows an alarm
+    ledAlarms.refresh(currentMillis, ledAlarmOutputs);
 }
 
-// Add a helper function to get alert descriptions
-String getAlertDescription(const String& alertCode) {
-    if (alertCode == "R01") return "All RED LEDs are OFF";
-    else if (alertCode == "R02") return "E-Stop is OFF";
-    else if (alertCode == "R15") return "OSG/Pit Switch activated";
-    else if (alertCode == "R23") return "Door Lock Failure";
-    else if (alertCode == "R22") return "Door Open";
-    else if (alertCode == "R00") return "No FLASHING RED LEDs";
-    else if (alertCode == "R31") return "Out of Service (flood switch)";
-    else if (alertCode == "R36") return "Out of Service – periodic maintenance";
-    else if (alertCode == "R37") return "Out of Service (travel time)";
-    else if (alertCode == "R07") return "Drive Train, Belt Failure";
-    else if (alertCode == "R03") return "Drive Nut Friction block fails";
-    else if (alertCode == "R27") return "Drive Train Alignment";
-    else if (alertCode == "R10") return "Final Limit";
-    else if (alertCode == "R11") return "Landing Switch (Top) failure";
-    else if (alertCode == "R12") return "Landing Switch (Mid) failure";
-    else if (alertCode == "R13") return "Landing Switch (Bottom) failure";
-    else if (alertCode == "R24") return "Drive Train Motor Failure";
-    else if (alertCode == "R05") return "Motor temperature failure";
-    
-    // Green alerts
-    else if (alertCode == "G01") return "All GREEN LEDs are OFF";
-    else if (alertCode == "G00") return "No exceptions";
-    else if (alertCode == "G02") return "No FLASHING GREEN LEDs";
-    else if (alertCode == "G03") return "On Battery Power";
-    else if (alertCode == "G04") return "Bypass Jumpers/Service Switch";
-    
-    // Amber alerts
-    else if (alertCode == "A01") return "ALL AMBER LEDs OFF";
-    else if (alertCode == "A04") return "Power Failure";
-    else if (alertCode == "A39") return "Power Failure";
-    else if (alertCode == "A30") return "Service Required (Flood switch)";
-    else if (alertCode == "A33") return "Service Required – travel time";
-    else if (alertCode == "A34") return "Service Required – maintenance";
-    else if (alertCode == "A35") return "Service Required – hours";
-    else if (alertCode == "A36") return "Service Required – Battery";
-    else if (alertCode == "A37") return "Service Required - Inverter";
-    else if (alertCode == "A02") return "No FLASHING AMBER LEDs";
-    else if (alertCode == "A32") return "Power Failure - UP Locked";
-    else if (alertCode == "A40") return "Power Failure";
-    else if (alertCode == "A06") return "Motor Failure - UP Locked";
-    else if (alertCode == "A08") return "Anti-Rock binding - UP Locked";
-    else if (alertCode == "A14") return "Bottom Final Limit - DOWN Locked";
-    else if (alertCode == "A16") return "Flood waters - DOWN Locked";
-    else if (alertCode == "A38") return "Motor Temperature monitoring lost";
-    
-    return "Unknown Alert Code";
+// Movement interlocks come before the alerts: the button outputs here, the command outputs
+// through commandTask
+void LEDAlarmOutputs::interlock(uint8_t flags) {
+    uint8_t opcode = buttonRelays.release(flags);
+    if (opcode == CMD_OP_STOP || opcode == CMD_OP_STOP_UP) addToLog("Stopped upward movement");
+    if (opcode == CMD_OP_STOP || opcode == CMD_OP_STOP_DOWN) addToLog("Stopped downward movement");
+    if (opcode) currentDirection = buttonRelays.upActive() ? "up" : buttonRelays.downActive() ? "down" : "none";
+    releaseCommandOutputs(flags);
 }
 
-void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
-  // Print sender MAC address
-  char macStr[18];
-  snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-           info->src_addr[0], info->src_addr[1], info->src_addr[2],
-           info->src_addr[3], info->src_addr[4], info->src_addr[5]);
-  Serial.print("ESP-NOW message from: ");
-  Serial.println(macStr);
-
-  // Copy and parse the message
-  memcpy(&incomingDataStruct, incomingData, sizeof(incomingDataStruct));
-
-  Serial.print("Type: ");
-  Serial.println(incomingDataStruct.type);
-  Serial.print("Payload: ");
-  Serial.println(incomingDataStruct.payload);
-
-  // If it's a command, trigger the appropriate action
-  // Update this in your OnDataRecv function
-if (strcmp(incomingDataStruct.type, "command") == 0) {
-  String cmd = String(incomingDataStruct.payload);
-  if (cmd == "UP") handleMovement("up");
-  else if (cmd == "DOWN") handleMovement("down");
-  else if (cmd == "STOP") stopMovement();
-  else if (cmd == "BRAKE") applyBrake();
-  else if (cmd == "RELEASE_BRAKE") releaseBrake();
-  else if (cmd == "STOP_UP") stopUpMovement();
-  else if (cmd == "STOP_DOWN") stopDownMovement();
+void LEDAlarmOutputs::alert(AlarmCode code) {
+    const AlarmInfo& info = alarmInfo(code);
+    char alertText[96];
+    snprintf(alertText, sizeof(alertText), "%s - %s", info.code, info.description);
+    publishAlert(alarmClassName(info.alarmClass), alertText);
+}
+
+// New function to process LED status
+void processLEDStatus(LEDStateWord ledWord, unsigned long currentMillis) {
+    LEDAlarmResult alarms = ledAlarms.apply(ledWord, currentMillis, ledAlarmOutputs);
+    ledStatusText.format(ledWord, alarms);
+
+    const AlarmInfo& redInfo = alarmInfo(alarms.red);
+    const AlarmInfo& greenInfo = alarmInfo(alarms.green);
+    const AlarmInfo& amberInfo = alarmInfo(alarms.amber);
+
+    // Send email for any red alarm if it's different from the last one sent
+    if (alarms.red != AlarmCode::None && lastRedEmailSent != redInfo.code) {
+        if (alarms.red == AlarmCode::R10) {
+            sendAlarmEmail("RED", "Final Limit (R10) - Lift has reached final limit switch");
+        } else {
+            sendAlarmEmail("RED", String(redInfo.code) + " - " + redInfo.description);
+        }
+        lastRedEmailSent = redInfo.code;
+    }
+
+    // Print, serve and record the status only when the classified state changed, e.g.
+    // "LED States - [0,0,0,0] [1,1,1,1] - R00/G00/A02"
+    const char* statusMsg = ledStatusText.summary;
+    bool snapshotChanged = strcmp(statusMsg, lastLedSnapshot) != 0;
+    if (snapshotChanged) {
+        Serial.println(statusMsg);
+        strlcpy(lastLedSnapshot, statusMsg, sizeof(lastLedSnapshot));
+    }
+
+    // Update the status served to web clients; unchanged values do not bump its sequence
+    if (statusMutex) {
+        xSemaphoreTake(statusMutex, portMAX_DELAY);
+        statusModel.setAlarms(alarms.red != AlarmCode::None ? redInfo.code : nullptr, amberInfo.code,
+                              alarms.green != AlarmCode::None ? greenInfo.code : nullptr);
+        if (snapshotChanged) statusModel.setLedStatus(ledStatusText.lines);
+        xSemaphoreGive(statusMutex);
+    }
+
+    // Update LED history
+    if (snapshotChanged) {
+        recordEvent(EventType::LedStatus, statusMsg, false);
+    }
 }
+
+// Runs in the WiFi task: only validates the frame and hands it to commandTask
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  postCommandFrame(incomingData, len, CommandTransport::EspNow, info->src_addr);
 }
 
 // Check if user is authenticated via cookie
@@ -992,19 +1486,6 @@ bool isAuthenticated() {
 
 TaskHandle_t arduinoTask = NULL;
 
-// Add debounce variables at the top with other globals
-unsigned long lastUpDebounceTime = 0;
-unsigned long lastDownDebounceTime = 0;
-bool lastUpButtonState = HIGH;
-bool lastDownButtonState = HIGH;
-bool upButtonState = HIGH;
-bool downButtonState = HIGH;
-const unsigned long DEBOUNCE_DELAY = 50;  // 50ms debounce time
-
-// Add at the top with other globals
-bool upButtonPressed = false;
-bool downButtonPressed = false;
-
 void setup() {
   Serial.begin(115200);
   delay(1000); // Give serial time to initialize
@@ -1015,6 +1496,14 @@ void setup() {
   // Do NOT call esp_task_wdt_init() or esp_task_wdt_add() here, as the TWDT and loopTask are already handled by the Arduino core.
   // No manual registration needed.
 
+  // Created before anything can publish or log
+  outboxMutex = xSemaphoreCreateMutex();
+  eventStoreMutex = xSemaphoreCreateMutex();
+  statusMutex = xSemaphoreCreateMutex();
+  eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(QueuedEvent));
+  commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(QueuedCommand));
+  statusModel.setMode(elevatorMode, elevatorMode ? ELEVATOR_MODE_DELAY : LIFT_MODE_DELAY);
+
   // Initialize SPIFFS
   if(!SPIFFS.begin(true)){
     Serial.println("An Error has occurred while mounting SPIFFS");
@@ -1022,6 +1511,23 @@ void setup() {
   }
   Serial.println("SPIFFS Initialized Successfully");
 
+  // Payloads carry the boot count so receivers can tell a restarted "seq" from a repeat
+  bootId = advanceBootCount(SPIFFS);
+
+  // Restore MQTT messages that were queued but not published before the last reset
+  mqttOutbox.load(SPIFFS);
+  Serial.print("MQTT outbox restored, pending messages: ");
+  Serial.println(mqttOutbox.depth());
+
+  // Find the event segments and rebuild the index of the one that was being written
+  xSemaphoreTake(eventStoreMutex, portMAX_DELAY);
+  eventStore.load(SPIFFS);
+  EventStoreStats eventStats = eventStore.getStats();
+  xSemaphoreGive(eventStoreMutex);
+  Serial.printf("Event store: %lu segments, %lu bytes, %lu corrupt records\n", (unsigned long)eventStats.segments,
+                (unsigned long)eventStats.bytes, (unsigned long)eventStats.corruptRecords);
+  xTaskCreatePinnedToCore(eventsTask, "events", 4096, NULL, 1, NULL, 0);
+
   // Check if required files exist
   if(!SPIFFS.exists("/index.html")) {
     Serial.println("Warning: index.html not found in SPIFFS");
@@ -1035,17 +1541,11 @@ void setup() {
     pinMode(redLEDs[i], INPUT);
     pinMode(greenLEDs[i], INPUT);
     // Initialize LED states
-    redLEDStates[i].currentState = false;
-    redLEDStates[i].lastState = false;
-    redLEDStates[i].changeCount = 0;
-    redLEDStates[i].lastChange = 0;
-    
-    greenLEDStates[i].currentState = false;
-    greenLEDStates[i].lastState = false;
-    greenLEDStates[i].changeCount = 0;
-    greenLEDStates[i].lastChange = 0;
+    redLEDStates[i] = {false, false, 0};
+    greenLEDStates[i] = {false, false, 0};
   }
-  Serial.println("LED pins initialized");
+  startLEDCapture();
+  Serial.println("LED pins initialized, capture task started");
 
   // Initialize GPIO with explicit states
   Serial.println("Initializing GPIO pins...");
@@ -1099,15 +1599,28 @@ void setup() {
     return;
   }
 
+  // Core 1 above loop(): a queued command preempts loop() instead of waiting for it
+  xTaskCreatePinnedToCore(commandTask, "command", 4096, NULL, 3, NULL, 1);
+
+  // ESP-NOW command receiver, on the same channel as the STA connection (see CommandFrame.h)
+#if CMD_FRAME_ESPNOW
+  if (esp_now_init() == ESP_OK) {
+    esp_now_register_recv_cb(OnDataRecv);
+    Serial.println("ESP-NOW initialized");
+  } else {
+    Serial.println("ESP-NOW initialization failed");
+  }
+#else
+  Serial.println("ESP-NOW commands disabled (CMD_FRAME_ESPNOW)");
+#endif
+
   // Setup MQTT with SSL/TLS
   espClient.setCACert(root_ca);
   mqttClient.setServer(mqtt_server, mqtt_port);
   mqttClient.setCallback(callback);
   mqttClient.setKeepAlive(60);
   mqttClient.setSocketTimeout(10);
-  
-  // Initial MQTT connection attempt
-  reconnectMQTT();
+  mqttClient.setBufferSize(MQTT_PAYLOAD_BUFFER_SIZE + FLEET_TOPIC_MAX + 8);  // Fixed header, per-unit topic, payload
   
   // Initialize NTP with local time cache
   Serial.println("Configuring time...");
@@ -1126,6 +1639,10 @@ void setup() {
   } else {
     Serial.println("Time synced successfully!");
   }
+
+  // MQTT runs on its own task from here on; started after the time sync for TLS
+  setupUnitTopics();
+  xTaskCreatePinnedToCore(mqttTask, "mqtt", 8192, NULL, 2, NULL, 0);
   
   Serial.println("=== Setup Complete ===\n");
 
@@ -1144,30 +1661,128 @@ void setup() {
     file.close();
   });
 
+  // Full state with recent history and counters, streamed as chunked JSON
   server.on("/getStatus", HTTP_GET, []() {
     if (!isAuthenticated()) return;
-    String response = "{";
-    response += "\"mode\":\"" + String(elevatorMode ? "elevator" : "lift") + "\",";
-    response += "\"delay\":\"" + String(elevatorMode ? ELEVATOR_MODE_DELAY : LIFT_MODE_DELAY) + "\",";
-    response += "\"logs\":\"" + serialLogs + "\",";
-    response += "\"ledStatus\":\"" + ledStatus + "\",";
-    response += "\"ledStatusHistory\":\"" + ledStatusHistory + "\",";
-    response += "\"greenAlarms\":\"" + greenAlarms + "\",";
-    response += "\"amberAlarms\":\"" + amberAlarms + "\",";
-    response += "\"redAlarms\":\"" + redAlarms + "\",";
-    response += "\"emailEnabled\":" + String(emailNotificationsEnabled ? "true" : "false") + ",";
-    response += "\"emails\":[";
-    for (int i = 0; i < emailCount; i++) {
-      if (i > 0) response += ",";
-      response += "\"" + emailAddresses[i] + "\"";
+    StatusModel snapshot = snapshotStatus();
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    JsonChunkWriter json(sendHttpChunk);
+    writeStatus(json, snapshot, STATUS_ALL_SECTIONS | STATUS_WITH_HISTORY | STATUS_WITH_STATS);
+    json.flush();
+    server.sendContent("");
+  });
+
+  // Delta status: /status?boot=<id>&since=<seq>[&stats=1] returns the sections changed
+  // after seq, or everything for an unknown boot id. The ETag is "<boot>-<seq>", and a
+  // matching If-None-Match (or nothing new since seq) gets 304.
+  server.on("/status", HTTP_GET, []() {
+    if (!isAuthenticated()) {
+      server.send(401, "text/plain", "Unauthorized");
+      return;
+    }
+    StatusModel snapshot = snapshotStatus();
+    char boot[STATUS_BOOT_ID_SIZE];
+    char etag[24];
+    formatBootId(boot, sizeof(boot), bootId);
+    snprintf(etag, sizeof(etag), "\"%s-%lu\"", boot, (unsigned long)snapshot.sequence());
+    bool withStats = server.arg("stats") == "1";
+    uint32_t since = 0;
+    uint32_t clientBoot;
+    if (parseBootId(server.arg("boot").c_str(), clientBoot) && clientBoot == bootId) {
+      since = strtoul(server.arg("since").c_str(), nullptr, 10);
+    }
+
+    server.sendHeader("ETag", etag);
+    server.sendHeader("Cache-Control", "no-cache");
+    bool unchanged = server.header("If-None-Match") == etag || (since != 0 && since == snapshot.sequence());
+    if (unchanged && !withStats) {
+      server.send(304);
+      return;
+    }
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    JsonChunkWriter json(sendHttpChunk);
+    writeStatus(json, snapshot, snapshot.changedSince(since) | (withStats ? STATUS_WITH_STATS : 0));
+    json.flush();
+    server.sendContent("");
+  });
+
+  // Push channel: Server-Sent Events with the full state on connect, then a "status"
+  // event with the changed sections at most every STATUS_PUSH_PERIOD_MS
+  server.on("/stream", HTTP_GET, []() {
+    if (!isAuthenticated()) {
+      server.send(401, "text/plain", "Unauthorized");
+      return;
+    }
+    int slot = -1;
+    bool streaming = false;
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+      if (sseClients[i] && !sseClients[i].connected()) sseClients[i].stop();
+      if (sseClients[i]) streaming = true;
+      else if (slot < 0) slot = i;
+    }
+    if (slot < 0) {
+      server.send(503, "text/plain", "Too many status streams");
+      return;
     }
-    response += "]}";
-    server.send(200, "application/json", response);
+    // The response stays open on our copy of the client after the handler returns
+    sseClients[slot] = server.client();
+    sseClients[slot].print("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                           "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n");
+    StatusModel snapshot = snapshotStatus();
+    pushStatus(slot, snapshot, STATUS_ALL_SECTIONS);
+    if (!streaming) ssePushedSeq = snapshot.sequence();
+  });
+
+  // Event history: /events?from=<unix>&to=<unix>&since=<seq>&types=log,led,alarm,command&limit=<n>
+  // Streamed as a chunked JSON array; each batch is copied out under the eventStore lock
+  // and sent after it is released, so a slow client never holds up logging
+  server.on("/events", HTTP_GET, []() {
+    if (!isAuthenticated()) return;
+    EventQuery query = {0, UINT32_MAX, EVENT_TYPES_ALL, 0};
+    if (server.hasArg("from")) query.fromTime = strtoul(server.arg("from").c_str(), nullptr, 10);
+    if (server.hasArg("to")) query.toTime = strtoul(server.arg("to").c_str(), nullptr, 10);
+    if (server.hasArg("since")) query.afterSequence = strtoul(server.arg("since").c_str(), nullptr, 10);
+    if (server.hasArg("types")) query.typeMask = eventTypeMask(server.arg("types").c_str());
+    uint32_t limit = EVENT_QUERY_DEFAULT_LIMIT;
+    if (server.hasArg("limit")) limit = strtoul(server.arg("limit").c_str(), nullptr, 10);
+    if (limit > EVENT_QUERY_MAX_LIMIT) limit = EVENT_QUERY_MAX_LIMIT;
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    JsonChunkWriter json(sendHttpChunk);
+    json.beginArray();
+
+    EventCursor cursor = {};
+    uint32_t sent = 0;
+    while (!cursor.done && sent < limit) {
+      uint16_t batch = limit - sent < EVENT_QUERY_CHUNK ? limit - sent : EVENT_QUERY_CHUNK;
+      uint16_t count = readEventBatch(query, cursor, batch);
+
+      for (uint16_t i = 0; i < count; i++) {
+        json.beginObject();
+        json.key("seq");
+        json.number(eventBatch[i].header.sequence);
+        json.key("time");
+        json.number(eventBatch[i].header.timestamp);
+        json.key("type");
+        json.string(eventTypeName(eventBatch[i].header.type));
+        json.key("text");
+        json.string(eventBatch[i].text);
+        json.endObject();
+      }
+      sent += count;
+    }
+    json.endArray();
+    json.flush();
+    server.sendContent("");
   });
 
   server.on("/toggleEmail", HTTP_GET, []() {
     if (!isAuthenticated()) return;
     emailNotificationsEnabled = server.arg("enabled") == "true";
+    touchStatus(StatusSection::Email);
     server.send(200, "text/plain", "Email notifications " + String(emailNotificationsEnabled ? "enabled" : "disabled"));
   });
 
@@ -1186,6 +1801,7 @@ void setup() {
       }
     }
     emailAddresses[emailCount++] = email;
+    touchStatus(StatusSection::Email);
     server.send(200, "text/plain", "Email added successfully");
   });
 
@@ -1201,11 +1817,15 @@ void setup() {
       emailAddresses[i] = emailAddresses[i + 1];
     }
     emailCount--;
+    touchStatus(StatusSection::Email);
     server.send(200, "text/plain", "Email removed successfully");
   });
 
-  // Start the server
+  // Start the server; requests and status streams are served by webServerTask() on core 0
+  const char* collectedHeaders[] = {"Cookie", "If-None-Match"};
+  server.collectHeaders(collectedHeaders, 2);
   server.begin();
+  xTaskCreatePinnedToCore(webServerTask, "web", 8192, NULL, 1, NULL, 0);
   Serial.println("HTTP server started");
 
   // Initialize alert system
@@ -1213,82 +1833,31 @@ void setup() {
 }
 
 void loop() {
-    static unsigned long lastWiFiCheck = 0;
-    static unsigned long lastMQTTCheck = 0;
     static unsigned long lastWDTReset = 0;
     static unsigned long lastLoopDelay = 0;
-    const unsigned long CHECK_INTERVAL = 5000;
+    static unsigned long lastCommandMetrics = 0;
     const unsigned long WDT_RESET_INTERVAL = 1000;
     unsigned long currentMillis = millis();
+    uint32_t loopStartUs = micros();
 
     // No need to manually reset the watchdog unless you have a long-running operation
     // If you add a long-running section, call esp_task_wdt_reset() there
 
-    if (currentMillis - lastWiFiCheck >= CHECK_INTERVAL) {
-        if (WiFi.status() != WL_CONNECTED) {
-            WiFi.disconnect();
-            WiFi.begin(ssid, password);
-        }
-        lastWiFiCheck = currentMillis;
-    }
-    if (currentMillis - lastMQTTCheck >= CHECK_INTERVAL) {
-        if (!mqttClient.connected()) {
-            reconnectMQTT();
-        }
-        lastMQTTCheck = currentMillis;
-    }
-    if (mqttClient.connected()) {
-        mqttClient.loop();
-    }
+    // WiFi and MQTT are handled by mqttTask(); nothing here waits on the network
     readDeviceOutputs();
-    
-    // Read the current state of buttons
-    int upReading = digitalRead(UP_BUTTON);
-    int downReading = digitalRead(DOWN_BUTTON);
-    
-    // Handle UP button with debounce
-    if (upReading != lastUpButtonState) {
-        lastUpDebounceTime = currentMillis;
-    }
-    
-    if ((currentMillis - lastUpDebounceTime) > DEBOUNCE_DELAY) {
-        if (upReading != upButtonState) {
-            upButtonState = upReading;
-            if (upButtonState == LOW && !upButtonPressed) {  // Button is newly pressed
-                upButtonPressed = true;
-                handleMovement("up");
-            } else if (upButtonState == HIGH && upButtonPressed) {  // Button is released
-                upButtonPressed = false;
-                if (!elevatorMode) {  // Only stop on release in lift mode
-                    stopMovement();
-                }
-            }
-        }
-    }
-    
-    // Handle DOWN button with debounce
-    if (downReading != lastDownButtonState) {
-        lastDownDebounceTime = currentMillis;
-    }
-    
-    if ((currentMillis - lastDownDebounceTime) > DEBOUNCE_DELAY) {
-        if (downReading != downButtonState) {
-            downButtonState = downReading;
-            if (downButtonState == LOW && !downButtonPressed) {  // Button is newly pressed
-                downButtonPressed = true;
-                handleMovement("down");
-            } else if (downButtonState == HIGH && downButtonPressed) {  // Button is released
-                downButtonPressed = false;
-                if (!elevatorMode) {  // Only stop on release in lift mode
-                    stopMovement();
-                }
-            }
-        }
+
+    if (currentMillis - lastCommandMetrics >= COMMAND_METRICS_INTERVAL) {
+        lastCommandMetrics = currentMillis;
+        publishCommandMetrics();
+        publishLoopMetrics();
     }
     
-    // Save the button readings for next loop
-    lastUpButtonState = upReading;
-    lastDownButtonState = downReading;
+    // Buttons: press moves, release stops in lift mode (elevator mode latches until stop)
+    buttonPanel.update(digitalRead(UP_BUTTON), digitalRead(DOWN_BUTTON), elevatorMode, currentMillis,
+                       [](uint8_t opcode) {
+                           if (opcode == CMD_OP_STOP) stopMovement();
+                           else handleMovement(opcode == CMD_OP_UP ? "up" : "down");
+                       });
     
     if (elevatorMode) {
         static bool lastUpLimit = false;
@@ -1301,6 +1870,11 @@ void loop() {
         }
     }
 
+    uint32_t loopElapsedUs = micros() - loopStartUs;
+    portENTER_CRITICAL(&loopStatsMux);
+    loopStats.record(loopElapsedUs, currentMillis);
+    portEXIT_CRITICAL(&loopStatsMux);
+
     // Replace delay(10) with non-blocking delay
     if (currentMillis - lastLoopDelay >= 5) {  // 5ms instead of 10ms
         lastLoopDelay = currentMillis;
@@ -1310,33 +1884,5 @@ void loop() {
 
 // Initialize alert system
 void initializeAlertSystem() {
-    redAlertState = {"", 0, 0, false, 0};
-    amberAlertState = {"", 0, 0, false, 0};
-    greenAlertState = {"", 0, 0, false, 0};
-}
-
-// Helper function to manage alert state changes
-bool shouldPublishAlert(AlertState &state, String newMessage, unsigned long currentMillis) {
-    // If message changed, reset stable count
-    if (newMessage != state.message) {
-        state.message = newMessage;
-        state.lastChangeTime = currentMillis;
-        state.stableCount = 0;
-        return false;
-    }
-    
-    // Check if state has been stable for debounce period
-    if (currentMillis - state.lastChangeTime >= ALERT_DEBOUNCE_TIME) {
-        state.stableCount++;
-        
-        // Only publish if state is stable and cooldown period has passed
-        if (state.stableCount >= 2 && 
-            currentMillis - state.lastPublishTime >= ALERT_COOLDOWN &&
-            newMessage != "") {
-            state.lastPublishTime = currentMillis;
-            return true;
-        }
-    }
-    
-    return false;
+    ledAlarms.reset();
 }  
\ No newline at end of file
@@ -0,0 +1,248 @@
+// StatusModel.h - Versioned controller state for delta polling and push updates
+//
+// Every change bumps one sequence number and stamps the section it touched, so a client
+// that has seen sequence N only needs the sections stamped after N. Together with a
+// per-boot id the sequence is also the ETag of the state. Values live in fixed buffers:
+// the web server task copies the model under the caller's lock and renders the copy, so
+// no String is shared with loop() while a response is being written.
+//
+// JsonChunkWriter renders JSON through a small fixed buffer and hands it to a sink (an
+// HTTP chunk, the open event streams) whenever it fills, so no response is built in full.
+
+#ifndef STATUS_MODEL_H
+#define STATUS_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATUS_LED_TEXT_SIZE 256
+#define STATUS_ALARM_CODE_SIZE 8
+#define JSON_CHUNK_SIZE 512
+#define JSON_MAX_DEPTH 4
+#define STATUS_BOOT_ID_SIZE 9  // 8 hex digits and the terminator
+
+enum class StatusSection : uint8_t {
+  Mode = 0,    // Lift or elevator mode and its delay
+  Leds = 1,    // Per-LED status text
+  Alarms = 2,  // Latest red, amber and green alarm codes
+  Email = 3,   // Email notification switch and recipients
+  Events = 4   // Newest event store sequence; the records come from /events?since=
+};
+#define STATUS_SECTION_COUNT 5
+#define STATUS_SECTION_BIT(section) (1u << (uint8_t)(section))
+#define STATUS_ALL_SECTIONS ((1u << STATUS_SECTION_COUNT) - 1)
+
+struct StatusState {
+  bool elevatorMode;
+  uint32_t delayMs;
+  char ledStatus[STATUS_LED_TEXT_SIZE];
+  char redAlarm[STATUS_ALARM_CODE_SIZE];
+  char amberAlarm[STATUS_ALARM_CODE_SIZE];
+  char greenAlarm[STATUS_ALARM_CODE_SIZE];
+  uint32_t eventSequence;
+};
+
+class StatusModel {
+ public:
+  uint32_t sequence() const { return seq; }
+  const StatusState& get() const { return state; }
+
+  // Sections stamped after `since`; all of them for a client that has seen nothing yet
+  // or a sequence from before a reboot
+  uint32_t changedSince(uint32_t since) const {
+    if (since == 0 || since > seq) return STATUS_ALL_SECTIONS;
+    uint32_t sections = 0;
+    for (uint8_t i = 0; i < STATUS_SECTION_COUNT; i++) {
+      if (sectionSeq[i] > since) sections |= 1u << i;
+    }
+    return sections;
+  }
+
+  // For state kept outside the model, e.g. the email list
+  void touch(StatusSection section) { sectionSeq[(uint8_t)section] = ++seq; }
+
+  void setMode(bool elevatorMode, uint32_t delayMs) {
+    if (elevatorMode == state.elevatorMode && delayMs == state.delayMs) return;
+    state.elevatorMode = elevatorMode;
+    state.delayMs = delayMs;
+    touch(StatusSection::Mode);
+  }
+
+  void setLedStatus(const char* text) {
+    if (copyText(state.ledStatus, sizeof(state.ledStatus), text)) touch(StatusSection::Leds);
+  }
+
+  // nullptr keeps the current code
+  void setAlarms(const char* red, const char* amber, const char* green) {
+    bool changed = false;
+    if (red) changed |= copyText(state.redAlarm, sizeof(state.redAlarm), red);
+    if (amber) changed |= copyText(state.amberAlarm, sizeof(state.amberAlarm), amber);
+    if (green) changed |= copyText(state.greenAlarm, sizeof(state.greenAlarm), green);
+    if (changed) touch(StatusSection::Alarms);
+  }
+
+  void setEventSequence(uint32_t sequence) {
+    if (sequence == state.eventSequence) return;
+    state.eventSequence = sequence;
+    touch(StatusSection::Events);
+  }
+
+ private:
+  StatusState state = {};
+  uint32_t seq = 0;
+  uint32_t sectionSeq[STATUS_SECTION_COUNT] = {};
+
+  static bool copyText(char* field, size_t size, const char* value) {
+    if (strncmp(field, value, size - 1) == 0) return false;
+    strncpy(field, value, size - 1);
+    field[size - 1] = '\0';
+    return true;
+  }
+};
+
+// ===== Boot id ===== //
+// The boot id goes out as 8 hex digits in "boot" and in the ETag, and clients send it back
+// in /status?boot=, so both directions use the same radix.
+
+inline void formatBootId(char* out, size_t size, uint32_t bootId) {
+  snprintf(out, size, "%08lx", (unsigned long)bootId);
+}
+
+inline bool parseBootId(const char* text, uint32_t& bootId) {
+  if (!text || !*text || strlen(text) > 8) return false;
+  char* end;
+  unsigned long value = strtoul(text, &end, 16);
+  if (*end != '\0') return false;
+  bootId = (uint32_t)value;
+  return true;
+}
+
+// ===== Streaming JSON writer ===== //
+
+typedef void (*JsonChunkSink)(const char* data, size_t length);
+
+class JsonChunkWriter {
+ public:
+  explicit JsonChunkWriter(JsonChunkSink sink) : sink(sink) {}
+
+  void beginObject() { open('{'); }
+  void endObject() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+
+  void key(const char* name) {
+    separate();
+    put('"');
+    raw(name);
+    raw("\":");
+    afterKey = true;
+  }
+
+  void string(const char* value) {
+    separate();
+    put('"');
+    escaped(value ? value : "");
+    put('"');
+  }
+
+  // A string value written in pieces, e.g. from records streamed out of the event store
+  void beginString() {
+    separate();
+    put('"');
+  }
+  void stringPart(const char* value) { escaped(value); }
+  void endString() { put('"'); }
+
+  void number(uint32_t value) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%lu", (unsigned long)value);
+    separate();
+    raw(digits);
+  }
+
+  void boolean(bool value) {
+    separate();
+    raw(value ? "true" : "false");
+  }
+
+  void raw(const char* s) {
+    for (; *s; s++) put(*s);
+  }
+
+  // Same escapes as MQTTPayload, so a text reads the same in /events, /stream and MQTT
+  void escaped(const char* s) {
+    for (; *s; s++) {
+      unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\') {
+        put('\\');
+        put(c);
+      } else if (c == '\n') {
+        raw("\\n");
+      } else if (c == '\r') {
+        raw("\\r");
+      } else if (c == '\t') {
+        raw("\\t");
+      } else if (c == '\b') {
+        raw("\\b");
+      } else if (c == '\f') {
+        raw("\\f");
+      } else if (c < 0x20) {
+        char esc[7];
+        snprintf(esc, sizeof(esc), "\\u%04x", c);
+        raw(esc);
+      } else {
+        put(c);
+      }
+    }
+  }
+
+  void flush() {
+    if (len > 0) sink(buf, len);
+    len = 0;
+  }
+
+  size_t bytesWritten() const { return total; }
+
+ private:
+  JsonChunkSink sink;
+  char buf[JSON_CHUNK_SIZE];
+  size_t len = 0;
+  size_t total = 0;
+  bool hasItem[JSON_MAX_DEPTH] = {};
+  uint8_t depth = 0;
+  bool afterKey = false;
+
+  void put(char c) {
+    if (len == sizeof(buf)) flush();
+    buf[len++] = c;
+    total++;
+  }
+
+  // Comma before every item but the first at this level; a value right after its key needs none
+  void separate() {
+    if (afterKey) {
+      afterKey = false;
+      return;
+    }
+    if (depth == 0 || depth > JSON_MAX_DEPTH) return;
+    if (hasItem[depth - 1]) put(',');
+    hasItem[depth - 1] = true;
+  }
+
+  void open(char c) {
+    separate();
+    put(c);
+    if (depth < JSON_MAX_DEPTH) hasItem[depth] = false;
+    depth++;
+  }
+
+  void close(char c) {
+    if (depth > 0) depth--;
+    put(c);
+  }
+};
+
+#endif // STATUS_MODEL_H
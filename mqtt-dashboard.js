@@ -21,6 +21,73 @@ const brokerConfig = {
     clientId: 'webClient_' + Math.random().toString(16).substr(2, 8)
 };
 
+// ===== Lift commands =====
+// The controller executes binary command frames (CommandFrame.h) only on its own topic,
+// usf/unit/<unit>/cmd/frame, and acks each one on usf/unit/<unit>/cmd/ack. The unit is the
+// ?unit= query parameter, else the controller that served this page (/status), else the
+// only unit heard on usf/unit/+/... so far.
+const CMD_OPCODES = { stop: 0x01, up: 0x02, down: 0x03, brake: 0x04, release: 0x05 };
+const CMD_STATUS_NAMES = ['ok', 'duplicate', 'stale', 'unknown'];
+const CMD_FRAME_SIZE = 24;
+const commandSenderId = crypto.getRandomValues(new Uint32Array(1))[0];  // Per page load
+let commandSequence = 0;
+const fleetUnits = new Set();
+
+function liftUnit() {
+    const requested = new URLSearchParams(window.location.search).get('unit');
+    if (requested) return requested;
+    if (window.controllerUnit) return window.controllerUnit;
+    return fleetUnits.size === 1 ? fleetUnits.values().next().value : null;
+}
+
+// command_frame_t: magic, version, opcode, status, sender_id, sequence, handled_us, sent_us
+function commandFrame(opcode) {
+    const frame = new DataView(new ArrayBuffer(CMD_FRAME_SIZE));
+    frame.setUint8(0, 0xC7);
+    frame.setUint8(1, 1);
+    frame.setUint8(2, opcode);
+    frame.setUint32(4, commandSenderId, true);
+    frame.setUint32(8, ++commandSequence, true);
+    frame.setBigUint64(16, BigInt(Date.now()) * 1000n, true);
+    return new Uint8Array(frame.buffer);
+}
+
+/**
+ * Sends a lift command to the selected unit
+ * @param {string} action - 'up', 'down', 'stop', 'brake' or 'release'
+ * @returns {boolean} false when it could not be sent
+ */
+function sendLiftFrame(action) {
+    if (!client || !client.connected) {
+        showMessage('Cannot send command: MQTT client is not connected', 'error');
+        return false;
+    }
+    const unit = liftUnit();
+    if (!unit) {
+        const heard = fleetUnits.size ? ` (heard: ${[...fleetUnits].join(', ')})` : '';
+        showMessage(`Cannot send command: choose a lift with ?unit=<id>${heard}`, 'error');
+        return false;
+    }
+    client.publish(`usf/unit/${unit}/cmd/frame`, commandFrame(CMD_OPCODES[action]), { qos: 1 }, (err) => {
+        if (err) logToCommandTerminal(`Failed to send ${action.toUpperCase()} to ${unit}`, 'error');
+    });
+    return true;
+}
+
+// Units announce themselves on their own topics; acks for this page's frames are logged
+function handleUnitMessage(topic, message) {
+    const parts = topic.split('/');
+    if (parts.length < 4) return;
+    const unit = parts[2];
+    fleetUnits.add(unit);
+    if (parts.slice(3).join('/') !== 'cmd/ack' || message.length !== CMD_FRAME_SIZE) return;
+    const ack = new DataView(message.buffer, message.byteOffset, CMD_FRAME_SIZE);
+    if (ack.getUint8(0) !== 0xC7 || ack.getUint32(4, true) !== commandSenderId) return;
+    const status = CMD_STATUS_NAMES[ack.getUint8(3)] || 'unknown';
+    logToCommandTerminal(`${unit} #${ack.getUint32(8, true)}: ${status} in ${ack.getUint32(12, true)} us`,
+                         status === 'ok' ? 'success' : 'error');
+}
+
 /**
  * Initializes the MQTT client and sets up connection handlers
  */
@@ -53,7 +120,9 @@ function initializeMQTTClient() {
             'usf/logs/general',
             'usf/logs/command',
             'usf/status',
-            'usf/telemetry'
+            'usf/telemetry',
+            'usf/unit/+/logs/general',
+            'usf/unit/+/cmd/ack'
         ];
         
         topics.forEach(topic => {
@@ -76,6 +145,10 @@ function initializeMQTTClient() {
 
     client.on('message', (topic, message) => {
         console.log('Received message on topic:', topic, 'Message:', message.toString());
+        if (topic.startsWith('usf/unit/')) {
+            handleUnitMessage(topic, message);
+            return;
+        }
         
         try {
             const payload = JSON.parse(message.toString());
@@ -173,7 +246,7 @@ function initializeEventHandlers() {
   document.querySelectorAll('.control-buttons .control-btn').forEach(button => {
     button.addEventListener('click', function() {
         if (!client || !client.connected) {
-            showError('MQTT client is not connected. Please check your connection.');
+            showMessage('MQTT client is not connected. Please check your connection.', 'error');
             return;
         }
 
@@ -805,19 +878,7 @@ terminalInput.addEventListener('keypress', (e) => {
             
             // Handle specific lift commands
             if (command === 'UP' || command === 'DOWN' || command === 'STOP') {
-                const liftPayload = {
-                    type: 'command',
-                    message: `COMMAND:${command}`,
-                    timestamp: new Date().toISOString()
-                };
-                
-                // Send to motor control topic
-                client.publish('usf/messages', JSON.stringify(liftPayload), { qos: 1 }, (err) => {
-                    if (err) {
-                        console.error('Failed to send lift command:', err);
-                        logToCommandTerminal('Failed to send lift command', 'error');
-                    }
-                });
+                sendLiftFrame(command.toLowerCase());
             }
             
             // Clear the input
@@ -859,22 +920,8 @@ document.head.querySelector('style').textContent += `
 
 // Function to send lift commands
 window.sendLiftCommand = function(command) {
-    const payload = {
-        type: 'command',
-        message: `COMMAND:${command}`,
-        timestamp: new Date().toISOString()
-    };
-    
-    // Log the command
     logToCommandTerminal(`> ${command}`, 'command');
-    
-    // Send to motor control topic
-    client.publish('usf/messages', JSON.stringify(payload), { qos: 1 }, (err) => {
-        if (err) {
-            console.error('Failed to send lift command:', err);
-            logToCommandTerminal('Failed to send lift command', 'error');
-        }
-    });
+    sendLiftFrame(command.toLowerCase());
 };
 
 // Clear log buttons
@@ -1674,68 +1721,23 @@ function logToControlTerminal(message, type = 'info') {
 
 // Update the control functions to use the new log types
 function startAction(direction) {
-    if (!client || !client.connected) {
-        showError('Cannot send command: MQTT client is not connected');
-        return;
-    }
-    
-    const topic = 'usf/logs/command';
-    const message = direction.toLowerCase();
-    client.publish(topic, message);
-    
-    // Log the action to the control terminal
-    const controlTerminal = document.getElementById('controlTerminal');
-    if (controlTerminal) {
-        appendToTerminal(controlTerminal, `Movement command sent: ${direction.toUpperCase()}`, 'command');
-    }
+    if (!sendLiftFrame(direction.toLowerCase())) return;
+    logToControlTerminal(`Movement command sent: ${direction.toUpperCase()}`, 'command');
 }
 
 function stopAction() {
-    if (!client || !client.connected) {
-        showError('Cannot send command: MQTT client is not connected');
-        return;
-    }
-    
-    const topic = 'usf/logs/command';
-    client.publish(topic, 'stop');
-    
-    // Log the action to the control terminal
-    const controlTerminal = document.getElementById('controlTerminal');
-    if (controlTerminal) {
-        appendToTerminal(controlTerminal, 'Movement STOPPED', 'command');
-    }
+    if (!sendLiftFrame('stop')) return;
+    logToControlTerminal('Movement STOPPED', 'command');
 }
 
 function applyBrake() {
-    if (!client || !client.connected) {
-        showError('Cannot send command: MQTT client is not connected');
-        return;
-    }
-    
-    const topic = 'usf/logs/command';
-    client.publish(topic, 'brake');
-    
-    // Log the action to the control terminal
-    const controlTerminal = document.getElementById('controlTerminal');
-    if (controlTerminal) {
-        appendToTerminal(controlTerminal, 'Brake APPLIED', 'command');
-    }
+    if (!sendLiftFrame('brake')) return;
+    logToControlTerminal('Brake APPLIED', 'command');
 }
 
 function releaseBrake() {
-    if (!client || !client.connected) {
-        showError('Cannot send command: MQTT client is not connected');
-        return;
-    }
-    
-    const topic = 'usf/logs/command';
-    client.publish(topic, 'release');
-    
-    // Log the action to the control terminal
-    const controlTerminal = document.getElementById('controlTerminal');
-    if (controlTerminal) {
-        appendToTerminal(controlTerminal, 'Brake RELEASED', 'command');
-    }
+    if (!sendLiftFrame('release')) return;
+    logToControlTerminal('Brake RELEASED', 'command');
 }
 
 // Add styles for control buttons
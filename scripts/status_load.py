@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Load test for the motor controller's /status and /stream endpoints.
+
+Pollers request /status?boot=<id>&since=<seq> the way the dashboard does, carrying the
+boot id and sequence from each reply, while stream clients hold /stream open and count
+the status events pushed to them. At the end it prints requests per second, p50/p99/max
+latency, the share of 304 replies, and errors.
+
+    python3 scripts/status_load.py http://192.168.4.1 --pollers 8 --streams 4 --seconds 60
+
+Only the Python standard library is used. The controller allows four streams
+(SSE_MAX_CLIENTS); extra stream clients get 503, which is counted as an error.
+"""
+
+import argparse
+import http.client
+import json
+import threading
+import time
+import urllib.parse
+
+
+class Results:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.status_codes = {}
+        self.errors = 0
+        self.stream_events = 0
+        self.stream_bytes = 0
+
+    def request(self, code, latency):
+        with self.lock:
+            self.latencies.append(latency)
+            self.status_codes[code] = self.status_codes.get(code, 0) + 1
+
+    def error(self):
+        with self.lock:
+            self.errors += 1
+
+    def stream_event(self, size):
+        with self.lock:
+            self.stream_events += 1
+            self.stream_bytes += size
+
+
+def connect(url, timeout):
+    if url.scheme == "https":
+        return http.client.HTTPSConnection(url.netloc, timeout=timeout)
+    return http.client.HTTPConnection(url.netloc, timeout=timeout)
+
+
+def poller(url, headers, interval, deadline, results):
+    conn = connect(url, 5)
+    boot, seq = None, 0
+    while time.monotonic() < deadline:
+        path = "/status"
+        if boot is not None:
+            path += "?" + urllib.parse.urlencode({"boot": boot, "since": seq})
+        start = time.monotonic()
+        try:
+            conn.request("GET", path, headers=headers)
+            response = conn.getresponse()
+            body = response.read()
+            results.request(response.status, time.monotonic() - start)
+            if response.status == 200:
+                update = json.loads(body)
+                boot, seq = update["boot"], update["seq"]
+            elif response.status != 304:
+                results.error()
+        except (OSError, http.client.HTTPException, ValueError, KeyError):
+            results.error()
+            conn.close()
+            conn = connect(url, 5)
+        time.sleep(interval)
+    conn.close()
+
+
+def streamer(url, headers, deadline, results):
+    while time.monotonic() < deadline:
+        # Heartbeats come every 15 s; a longer silence is a dead stream unless the test is over
+        conn = connect(url, max(1.0, min(20.0, deadline - time.monotonic())))
+        try:
+            conn.request("GET", "/stream", headers=headers)
+            response = conn.getresponse()
+            if response.status != 200:
+                response.read()
+                results.error()
+                time.sleep(1)
+                continue
+            while time.monotonic() < deadline:
+                line = response.fp.readline()
+                if not line:
+                    break
+                if line.startswith(b"data: "):
+                    json.loads(line[6:])
+                    results.stream_event(len(line))
+        except (OSError, http.client.HTTPException, ValueError):
+            if time.monotonic() < deadline:
+                results.error()
+        finally:
+            conn.close()
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("url", help="controller base URL, e.g. http://192.168.4.1")
+    parser.add_argument("--pollers", type=int, default=8, help="concurrent /status pollers")
+    parser.add_argument("--streams", type=int, default=2, help="concurrent /stream clients")
+    parser.add_argument("--interval", type=float, default=0.5, help="seconds between polls per poller")
+    parser.add_argument("--seconds", type=float, default=30, help="test duration")
+    parser.add_argument("--session", default="loadtest", help="SESSIONID cookie value")
+    args = parser.parse_args()
+
+    url = urllib.parse.urlsplit(args.url)
+    headers = {"Cookie": "SESSIONID=" + args.session}
+    results = Results()
+    deadline = time.monotonic() + args.seconds
+    threads = [threading.Thread(target=poller, args=(url, headers, args.interval, deadline, results))
+               for _ in range(args.pollers)]
+    threads += [threading.Thread(target=streamer, args=(url, headers, deadline, results))
+                for _ in range(args.streams)]
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    for thread in threads:
+        thread.join(args.seconds + 30)
+
+    latencies = sorted(results.latencies)
+    requests = len(latencies)
+    not_modified = results.status_codes.get(304, 0)
+    print("requests:      %d (%.1f/s)" % (requests, requests / args.seconds))
+    print("status codes:  %s" % ", ".join("%d: %d" % item for item in sorted(results.status_codes.items())))
+    print("304 ratio:     %.1f%%" % (100.0 * not_modified / requests if requests else 0))
+    print("latency ms:    p50 %.1f  p99 %.1f  max %.1f" % (percentile(latencies, 50) * 1000,
+                                                         percentile(latencies, 99) * 1000,
+                                                         (latencies[-1] if latencies else 0) * 1000))
+    print("stream events: %d (%d bytes)" % (results.stream_events, results.stream_bytes))
+    print("errors:        %d" % results.errors)
+    return 1 if results.errors else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
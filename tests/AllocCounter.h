@@ -0,0 +1,20 @@
+// AllocCounter.h - Counts heap allocations made by the process (glibc only)
+//
+// Wraps malloc, which operator new also goes through. Include in exactly one translation unit.
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" void* __libc_malloc(size_t size);
+
+static uint64_t heapAllocations = 0;
+
+extern "C" void* malloc(size_t size) {
+  heapAllocations++;
+  return __libc_malloc(size);
+}
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,136 @@
+// Alert gates fed by the alarm refresh, the LED alarm handler and status text, the button
+// panel and the relay pair's break-before-make
+
+#include <string>
+#include <vector>
+#include "TestUtil.h"
+#include "ControllerLogic.h"
+
+// Records pin writes with the time they happen at; wait() advances the clock
+struct FakeRelays {
+  uint32_t clockUs = 0;
+  bool level[2] = {};
+  std::vector<std::string> writes;
+  void write(uint8_t pin, bool on) {
+    level[pin] = on;
+    writes.push_back(std::to_string(clockUs) + (pin ? " down " : " up ") + (on ? "on" : "off"));
+  }
+  void wait(uint32_t us) { clockUs += us; }
+  uint32_t nowUs() { return clockUs; }
+};
+
+struct FakeOutputs {
+  uint8_t interlocks = 0;
+  std::vector<AlarmCode> alerts;
+  void interlock(uint8_t flags) { interlocks |= flags; }
+  void alert(AlarmCode code) { alerts.push_back(code); }
+};
+
+// Feeds word to a red alert gate once, as its snapshot does, then from the refresh only.
+// Returns the ms from the snapshot to the publish, or 0 if nothing is published in 3 s.
+static uint32_t redPublishDelay(LEDStateWord word) {
+  AlertGate gate;
+  AlarmRefresh refresh;
+  const uint32_t startMs = ALERT_COOLDOWN;  // Past the cooldown that follows boot
+  LEDAlarmResult alarms = decodeLEDAlarms(word);
+  CHECK(!gate.update(alarms.red, startMs));
+  refresh.seen(word, alarms, startMs);
+  LEDStateWord again;
+  for (uint32_t nowMs = startMs + 1; nowMs <= startMs + 3000; nowMs++) {
+    if (refresh.due(nowMs, again) && gate.update(decodeLEDAlarms(again).red, nowMs)) return nowMs - startMs;
+  }
+  return 0;
+}
+
+int main() {
+  // A steady red pattern arrives as one snapshot and is published after the debounce
+  LEDStateWord estop = packLEDState(0xF, 0, 0, 0);
+  CHECK(decodeLEDAlarms(estop).red == AlarmCode::R00);
+  uint32_t delayMs = redPublishDelay(estop);
+  CHECK(delayMs >= ALERT_DEBOUNCE_TIME);
+  CHECK(delayMs <= ALERT_DEBOUNCE_TIME + 2 * ALERT_REFRESH_MS);
+
+  // So is a flash-coded one
+  LEDStateWord flood = packLEDState(0, 0x2, 0, 0);
+  CHECK(decodeLEDAlarms(flood).red == AlarmCode::R31);
+  delayMs = redPublishDelay(flood);
+  CHECK(delayMs >= ALERT_DEBOUNCE_TIME);
+  CHECK(delayMs <= ALERT_DEBOUNCE_TIME + 2 * ALERT_REFRESH_MS);
+
+  // A word with no alarm in any class is not refreshed
+  LEDStateWord quiet = 0;
+  bool found = false;
+  for (uint32_t word = 0; word <= 0xFFFF && !found; word++) {
+    LEDAlarmResult alarms = decodeLEDAlarms((LEDStateWord)word);
+    found = alarms.red == AlarmCode::None && alarms.green == AlarmCode::None && alarms.amber == AlarmCode::None;
+    if (found) quiet = (LEDStateWord)word;
+  }
+  CHECK(found);
+  AlarmRefresh refresh;
+  LEDStateWord again;
+  refresh.seen(quiet, decodeLEDAlarms(quiet), 0);
+  CHECK(!refresh.due(10000, again));
+  refresh.seen(estop, decodeLEDAlarms(estop), 0);
+  CHECK(!refresh.due(ALERT_REFRESH_MS - 1, again));
+  CHECK(refresh.due(ALERT_REFRESH_MS, again) && again == estop);
+
+  // The handler interlocks on the snapshot and publishes from its refresh
+  LEDAlarmHandler handler;
+  FakeOutputs outputs;
+  LEDAlarmResult alarms = handler.apply(estop, ALERT_COOLDOWN, outputs);
+  CHECK_EQ(outputs.interlocks, INTERLOCK_UP | INTERLOCK_DOWN);
+  CHECK(outputs.alerts.empty());
+  for (uint32_t nowMs = ALERT_COOLDOWN + 1; nowMs <= ALERT_COOLDOWN + 2000; nowMs++) handler.refresh(nowMs, outputs);
+  CHECK_EQ(outputs.alerts.size(), 3u);
+  CHECK(outputs.alerts[0] == AlarmCode::R00);
+  CHECK(std::string(alarmClassName(alarmInfo(outputs.alerts[0]).alarmClass)) == "red");
+  handler.reset();
+  CHECK(!handler.refresh(ALERT_COOLDOWN + 3000, outputs));
+
+  // Status text
+  LEDStatusText text;
+  text.format(flood, decodeLEDAlarms(flood));
+  CHECK(std::string(text.summary) == "LED States - [0,2,0,0] [0,0,0,0] - R31/A02");
+  CHECK(std::string(text.lines).find("Red LED 0: OFF\nGreen LED 0: OFF\nRed LED 1: FLASHING\n") == 0);
+  text.format(estop, alarms);
+  CHECK(std::string(text.summary) == "LED States - [1,1,1,1] [0,0,0,0] - R00/G01/A02");
+  CHECK(std::string(text.lines).find("Red LED 3: ON\nGreen LED 3: OFF\n") != std::string::npos);
+
+  // Buttons: a press moves, a release stops only in lift mode
+  ButtonPanel panel(BUTTON_DEBOUNCE_MS);
+  std::vector<uint8_t> ops;
+  auto record = [&ops](uint8_t opcode) { ops.push_back(opcode); };
+  panel.update(true, true, false, 0, record);
+  panel.update(false, true, false, 10, record);
+  panel.update(false, true, false, 11 + BUTTON_DEBOUNCE_MS, record);
+  panel.update(true, false, false, 200, record);
+  panel.update(true, false, false, 201 + BUTTON_DEBOUNCE_MS, record);
+  CHECK(ops == std::vector<uint8_t>({CMD_OP_UP, CMD_OP_STOP, CMD_OP_DOWN}));
+  ops.clear();
+  panel.update(true, true, true, 400, record);
+  panel.update(true, true, true, 401 + BUTTON_DEBOUNCE_MS, record);
+  CHECK(ops.empty());
+
+  // Relays: a reversal opens the running output and waits the dead time before closing
+  FakeRelays relays;
+  RelayPair<FakeRelays> pair(relays, 0, 1, RELAY_REVERSE_DEADTIME_US);
+  uint32_t gapUs;
+  CHECK(pair.execute(CMD_OP_UP, gapUs) && gapUs == 0);
+  CHECK(pair.execute(CMD_OP_DOWN, gapUs));
+  CHECK_EQ(gapUs, RELAY_REVERSE_DEADTIME_US);
+  CHECK(relays.writes == std::vector<std::string>({"0 up on", "0 up off", "10000 down on"}));
+  CHECK(!pair.upActive() && pair.downActive());
+  CHECK(!pair.execute(CMD_OP_BRAKE, gapUs));
+
+  // Interlocks stop only the running outputs they cover
+  CHECK_EQ(pair.releaseOpcode(INTERLOCK_UP), 0);
+  CHECK_EQ(pair.releaseOpcode(INTERLOCK_UP | INTERLOCK_DOWN), CMD_OP_STOP_DOWN);
+  CHECK_EQ(pair.release(INTERLOCK_DOWN), CMD_OP_STOP_DOWN);
+  CHECK(!relays.level[1] && !pair.downActive());
+  CHECK_EQ(pair.release(INTERLOCK_DOWN), 0);
+  pair.execute(CMD_OP_UP, gapUs);
+  CHECK(gapUs == 0);
+  CHECK_EQ(pair.releaseOpcode(INTERLOCK_UP | INTERLOCK_DOWN), CMD_OP_STOP_UP);
+
+  return testResult("ControllerLogicTest");
+}
@@ -0,0 +1,102 @@
+// Alarm retention under a flood of LED records, reload after a reboot and ordered queries
+
+#define EVENT_SEGMENT_BYTES 4096
+#define EVENT_MAX_SEGMENTS 4
+#define EVENT_ALARM_ARCHIVE_BYTES 2048
+
+#include <string>
+#include <vector>
+#include "TestUtil.h"
+#include "HostFS.h"
+#include "EventStore.h"
+
+struct Read {
+  uint32_t sequence;
+  uint32_t timestamp;
+  uint8_t type;
+  std::string text;
+};
+
+static std::vector<Read> query(EventStore& store, HostFS& fs, uint32_t typeMask, uint32_t afterSequence = 0) {
+  std::vector<Read> records;
+  EventQuery q = {0, UINT32_MAX, typeMask, afterSequence};
+  EventCursor cursor = {};
+  while (!cursor.done) {
+    store.readChunk(fs, q, cursor, 16, [&](const EventRecordHeader& header, const char* payload) {
+      records.push_back({header.sequence, header.timestamp, header.type, payload});
+    });
+  }
+  return records;
+}
+
+static bool ordered(const std::vector<Read>& records) {
+  for (size_t i = 1; i < records.size(); i++) {
+    if (records[i].sequence <= records[i - 1].sequence || records[i].timestamp < records[i - 1].timestamp) return false;
+  }
+  return true;
+}
+
+static void appendText(EventStore& store, HostFS& fs, EventType type, uint32_t time, const std::string& text) {
+  store.append(fs, type, time, text.c_str(), text.size());
+}
+
+static EventStore store;
+static EventStore reloaded;
+
+int main() {
+  HostFS fs;
+  store.load(fs);
+
+  // 20 alarms among 5000 LED records: the LED records cycle through the segments many times
+  uint32_t time = 1700000000;
+  for (int i = 0; i < 5000; i++) {
+    appendText(store, fs, EventType::LedStatus, time++, "LED States - [0,0,0,0] [1,1,1,1] - G00 #" + std::to_string(i));
+    if (i % 250 == 0) appendText(store, fs, EventType::Alarm, time++, "red: R02 - E-Stop is OFF #" + std::to_string(i / 250));
+    if (i % 100 == 0) store.flush(fs);
+  }
+  store.flush(fs);
+
+  std::vector<Read> alarms = query(store, fs, EVENT_TYPE_BIT(EventType::Alarm));
+  CHECK_EQ(alarms.size(), 20);
+  CHECK(!alarms.empty() && alarms.front().text == "red: R02 - E-Stop is OFF #0");
+  CHECK(ordered(alarms));
+  CHECK(store.getStats().archivedAlarms > 0);
+  CHECK(store.oldestTime() == 1700000001);  // The first alarm, long after its segment was deleted
+
+  // LED records stay within the segment budget; everything comes back in sequence order
+  std::vector<Read> all = query(store, fs, EVENT_TYPES_ALL);
+  CHECK(ordered(all));
+  CHECK(all.size() < 5020);
+  CHECK_EQ(all.back().sequence, 5020);
+  CHECK(store.getStats().bytes <= EVENT_MAX_SEGMENTS * EVENT_SEGMENT_BYTES + EVENT_ALARM_ARCHIVE_BYTES);
+
+  // Catching up after a known sequence includes nothing older
+  std::vector<Read> newer = query(store, fs, EVENT_TYPES_ALL, 5000);
+  CHECK_EQ(newer.size(), 20);
+  CHECK(!newer.empty() && newer.front().sequence == 5001);
+
+  // Reboot: the archive and segments are found again and the sequence continues
+  reloaded.load(fs);
+  std::vector<Read> alarmsAfterReboot = query(reloaded, fs, EVENT_TYPE_BIT(EventType::Alarm));
+  CHECK_EQ(alarmsAfterReboot.size(), 20);
+  CHECK_EQ(reloaded.getStats().archivedAlarms, store.getStats().archivedAlarms);
+  CHECK_EQ(reloaded.lastSequence(), 5020);
+  CHECK_EQ(reloaded.getStats().corruptRecords, 0);
+
+  // An alarm storm fills the archive, which then keeps its newest half
+  for (int i = 0; i < 3000; i++) {
+    appendText(reloaded, fs, i % 5 ? EventType::LedStatus : EventType::Alarm, time++, "storm #" + std::to_string(i));
+    if (i % 50 == 0) reloaded.flush(fs);
+  }
+  reloaded.flush(fs);
+  alarms = query(reloaded, fs, EVENT_TYPE_BIT(EventType::Alarm));
+  CHECK(ordered(alarms));
+  CHECK(!alarms.empty() && alarms.back().text == "storm #2995");
+  CHECK(reloaded.getStats().archivedAlarms > 0);
+  CHECK(alarms.size() < 600 && alarms.front().text.compare(0, 6, "storm ") == 0);  // Oldest half dropped
+  all = query(reloaded, fs, EVENT_TYPES_ALL);
+  CHECK(ordered(all));
+  CHECK(reloaded.getStats().bytes <= EVENT_MAX_SEGMENTS * EVENT_SEGMENT_BYTES + EVENT_ALARM_ARCHIVE_BYTES);
+
+  return testResult("EventStoreTest");
+}
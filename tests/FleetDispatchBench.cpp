@@ -0,0 +1,74 @@
+// Dispatch cost per message for a 60-unit fleet publishing the controller's topic mix
+
+#include <cstdlib>
+#include "TestUtil.h"
+#include "AllocCounter.h"
+#include "FleetDispatch.h"
+
+static fleet_table_t table;
+
+static void onLog(fleet_unit_t *unit, const char *data, int len) {
+  static const char *const keys[] = {"type", "message", "timestamp"};
+  fleet_slice_t values[3];
+  if (fleet_json_fields(data, len, keys, values, 3) != 3) return;
+  char text[FLEET_TEXT_MAX];
+  fleet_slice_copy(text, sizeof(text), values[1]);
+  if (fleet_slice_eq(values[0], "amber")) fleet_note_alert(unit, FLEET_LEVEL_AMBER, text);
+}
+
+static void onAck(fleet_unit_t *unit, const char *, int) {
+  unit->commands++;
+}
+
+static void onLoop(fleet_unit_t *unit, const char *data, int len) {
+  static const char *const keys[] = {"iterations_per_s", "max_us"};
+  fleet_slice_t values[2];
+  fleet_json_fields(data, len, keys, values, 2);
+  unit->loop_hz = fleet_slice_uint(values[0]);
+  unit->loop_max_us = fleet_slice_uint(values[1]);
+}
+
+static const fleet_route_t routes[] = {
+    {"logs/command", onLog}, {"logs/alerts", onLog}, {"cmd/ack", onAck}, {"metrics/loop", onLoop}};
+
+int main() {
+  const int UNITS = 60, MESSAGES = 2000000;
+  static const char *const topics[] = {"usf/logs/command", "usf/logs/alerts", "usf/cmd/ack", "usf/metrics/loop"};
+  static const char *const payloads[] = {
+      "{\"seq\":1042,\"type\":\"command\",\"message\":\"Command executed: UP (MQTT #77)\",\"timestamp\":\"2025-06-01 12:00:00\"}",
+      "{\"seq\":1043,\"type\":\"amber\",\"alert_type\":\"amber\",\"message\":\"A16 - Flood waters - DOWN Locked\","
+      "\"led_code\":\"0100-1000\",\"timestamp\":\"2025-06-01 12:00:00\"}",
+      "\xc7\x01\x80\x00............................",
+      "{\"seq\":1044,\"type\":\"loop_metrics\",\"window_s\":60,\"iterations_per_s\":48211,\"p50_us\":12,\"p99_us\":40,"
+      "\"max_us\":912,\"mean_us\":15,\"reversals\":3,\"min_gap_us\":10012,\"max_gap_us\":10140,"
+      "\"min_free_heap\":180224,\"timestamp\":\"2025-06-01 12:00:00\"}"};
+  static char unitTopics[UNITS * 4][FLEET_TOPIC_MAX];
+  static int topicLengths[UNITS * 4];
+  int payloadLengths[4];
+  for (int k = 0; k < 4; k++) payloadLengths[k] = (int)strlen(payloads[k]);
+  for (int u = 0; u < UNITS; u++) {
+    char id[16];
+    snprintf(id, sizeof(id), "lift-%06x", u * 104729);
+    for (int k = 0; k < 4; k++) {
+      fleet_unit_topic(unitTopics[u * 4 + k], FLEET_TOPIC_MAX, id, topics[k]);
+      topicLengths[u * 4 + k] = (int)strlen(unitTopics[u * 4 + k]);
+    }
+  }
+
+  uint32_t seed = 1;
+  uint64_t allocations = heapAllocations;
+  uint64_t start = nowNs();
+  for (int i = 0; i < MESSAGES; i++) {
+    seed = seed * 1103515245u + 12345u;
+    int x = (int)((seed >> 8) % (UNITS * 4));
+    fleet_dispatch(&table, routes, 4, unitTopics[x], topicLengths[x], payloads[x & 3], payloadLengths[x & 3], i);
+  }
+  double ns = (double)(nowNs() - start) / MESSAGES;
+  allocations = heapAllocations - allocations;
+  keep(table);
+
+  std::printf("units %u, %.0f ns/message (%.0f messages/s), %llu allocations\n", table.count, ns, 1e9 / ns,
+              (unsigned long long)allocations);
+  std::printf("%zu B per unit, table %zu B\n", sizeof(fleet_unit_t), sizeof(fleet_table_t));
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Unit topics, in-place JSON fields, the unit table, fragment reassembly and per-class alarm
+// levels of the HMI's fleet dispatcher
+
+#include <string>
+#include "TestUtil.h"
+#include "FleetDispatch.h"
+
+static fleet_table_t table;
+static int logs = 0, acks = 0;
+static std::string lastMessage;
+
+// Mirrors the HMI's on_unit_log(): alerts update the unit's per-class level
+static void onLog(fleet_unit_t *unit, const char *data, int len) {
+  static const char *const keys[] = {"type", "message", "timestamp"};
+  fleet_slice_t values[3];
+  if (fleet_json_fields(data, len, keys, values, 3) != 3) return;
+  char text[64];
+  fleet_slice_copy(text, sizeof(text), values[1]);
+  lastMessage = text;
+  logs++;
+  uint8_t level = fleet_slice_eq(values[0], "red")     ? FLEET_LEVEL_RED
+                  : fleet_slice_eq(values[0], "amber") ? FLEET_LEVEL_AMBER
+                  : fleet_slice_eq(values[0], "green") ? FLEET_LEVEL_GREEN
+                                                       : FLEET_LEVEL_NONE;
+  if (level != FLEET_LEVEL_NONE) {
+    unit->alerts++;
+    fleet_note_alert(unit, level, text);
+  }
+}
+
+static void onAck(fleet_unit_t *, const char *, int) {
+  acks++;
+}
+
+static const fleet_route_t routes[] = {{"logs/command", onLog}, {"logs/alerts", onLog}, {"cmd/ack", onAck}};
+static const int ROUTE_COUNT = 3;
+
+static void alert(const char *unit, const char *type, const char *message, int64_t nowUs) {
+  char topic[FLEET_TOPIC_MAX];
+  fleet_unit_topic(topic, sizeof(topic), unit, "usf/logs/alerts");
+  std::string json = std::string("{\"type\":\"") + type + "\",\"message\":\"" + message + "\",\"timestamp\":\"t\"}";
+  fleet_dispatch(&table, routes, ROUTE_COUNT, topic, (int)strlen(topic), json.c_str(), (int)json.size(), nowUs);
+}
+
+int main() {
+  // Topics
+  char topic[FLEET_TOPIC_MAX];
+  CHECK(fleet_unit_topic(topic, sizeof(topic), "lift-1a2b3c", "usf/logs/alerts"));
+  CHECK(std::string(topic) == "usf/unit/lift-1a2b3c/logs/alerts");
+  CHECK(!fleet_unit_topic(topic, sizeof(topic), "x", "other/a"));
+  char small[10];
+  CHECK(!fleet_unit_topic(small, sizeof(small), "lift-1a2b3c", "usf/logs/alerts"));
+  fleet_slice_t unit, suffix;
+  CHECK(fleet_topic_split(topic, (int)strlen(topic), &unit, &suffix));
+  CHECK_EQ(unit.len, 11);
+  CHECK(fleet_slice_eq(suffix, "logs/alerts"));
+  CHECK(!fleet_topic_split("usf/unit//x", 11, &unit, &suffix));
+  CHECK(!fleet_topic_split("usf/unit/abc", 12, &unit, &suffix));
+  CHECK(!fleet_topic_split("usf/unit/abc/", 13, &unit, &suffix));
+
+  // JSON fields are found at the top level only, strings unescaped on copy
+  const char *json = " { \"seq\": 12, \"type\":\"red\", \"nested\": {\"type\":\"x\",\"a\":[1,\"}\"]}, "
+                     "\"message\":\"a \\\"q\\\" \\n b\\u00e9\", \"timestamp\":\"2025\" , \"t\":true } ";
+  static const char *const keys[] = {"type", "message", "timestamp", "seq", "t", "missing"};
+  fleet_slice_t values[6];
+  CHECK_EQ(fleet_json_fields(json, (int)strlen(json), keys, values, 6), 5);
+  CHECK(fleet_slice_eq(values[0], "red"));
+  CHECK(fleet_slice_eq(values[2], "2025"));
+  CHECK_EQ(fleet_slice_uint(values[3]), 12);
+  CHECK(fleet_slice_eq(values[4], "true"));
+  CHECK(values[5].ptr == nullptr);
+  char buffer[64];
+  fleet_slice_copy(buffer, sizeof(buffer), values[1]);
+  CHECK(std::string(buffer) == "a \"q\" \n b?");
+  fleet_slice_copy(buffer, 4, values[1]);
+  CHECK(std::string(buffer) == "a \"");
+  CHECK_EQ(fleet_json_fields("[1]", 3, keys, values, 6), -1);
+  CHECK_EQ(fleet_json_fields("{\"type\":\"red\"", 13, keys, values, 6), -1);
+  CHECK_EQ(fleet_json_fields("{}", 2, keys, values, 6), 0);
+  CHECK_EQ(fleet_json_fields("{\"type\" \"x\"}", 12, keys, values, 6), -1);
+  for (int n = 0; n <= (int)strlen(json); n++) fleet_json_fields(json, n, keys, values, 6);
+
+  // Unit table: FLEET_MAX_UNITS units, then full
+  for (int i = 0; i < FLEET_MAX_UNITS + 6; i++) {
+    char id[16];
+    int n = snprintf(id, sizeof(id), "lift-%06x", i * 7919);
+    fleet_unit_t *found = fleet_find(&table, id, n, true);
+    CHECK(i < FLEET_MAX_UNITS ? found != nullptr : found == nullptr);
+  }
+  for (int i = 0; i < FLEET_MAX_UNITS; i++) {
+    char id[16];
+    int n = snprintf(id, sizeof(id), "lift-%06x", i * 7919);
+    CHECK(fleet_find(&table, id, n, false) == &table.units[i]);
+  }
+  CHECK(fleet_find(&table, "nope", 4, false) == nullptr);
+  const uint8_t mac[6] = {0x24, 0x6f, 0x28, 0x1a, 0x2b, 0x3c};
+  CHECK(fleet_find_mac(&table, mac) == nullptr);
+  memcpy(table.units[5].espnow_mac, mac, sizeof(mac));
+  table.units[5].espnow_known = true;
+  CHECK(fleet_find_mac(&table, mac) == &table.units[5]);
+  memset(&table, 0, sizeof(table));
+
+  // Reassembly: fragments are joined, passthrough is zero-copy, bad sequences are dropped
+  static fleet_reassembly_t rx;
+  const char *message = "{\"type\":\"red\",\"message\":\"R02 - fragmented alarm\",\"timestamp\":\"now\"}";
+  const char *alertTopic = "usf/unit/lift-a/logs/alerts";
+  int total = (int)strlen(message), alertTopicLen = (int)strlen(alertTopic);
+  const char *t = alertTopic, *d = message;
+  int tl = alertTopicLen, dl = 10;
+  CHECK(!fleet_reassemble(&rx, &t, &tl, &d, &dl, 0, total));
+  for (int offset = 10; offset < total; offset += 10) {
+    t = nullptr;
+    tl = 0;
+    d = message + offset;
+    dl = total - offset < 10 ? total - offset : 10;
+    bool last = offset + dl == total;
+    CHECK(fleet_reassemble(&rx, &t, &tl, &d, &dl, offset, total) == last);
+  }
+  CHECK(d == rx.data && dl == total && memcmp(d, message, total) == 0);
+  CHECK(tl == alertTopicLen && memcmp(t, alertTopic, tl) == 0);
+  CHECK_EQ(rx.joined, 1);
+  fleet_dispatch(&table, routes, ROUTE_COUNT, t, tl, d, dl, 1);
+  CHECK(lastMessage == "R02 - fragmented alarm");
+
+  t = alertTopic;
+  tl = alertTopicLen;
+  d = message;
+  dl = total;
+  CHECK(fleet_reassemble(&rx, &t, &tl, &d, &dl, 0, total) && d == message);
+  dl = 10;
+  CHECK(!fleet_reassemble(&rx, &t, &tl, &d, &dl, 0, total));
+  d = message + 20;
+  CHECK(!fleet_reassemble(&rx, &t, &tl, &d, &dl, 20, total));
+  CHECK_EQ(rx.dropped, 1);
+  d = message;
+  CHECK(!fleet_reassemble(&rx, &t, &tl, &d, &dl, 0, FLEET_MESSAGE_MAX + 1));
+  CHECK_EQ(rx.dropped, 2);
+  dl = total;
+  CHECK(fleet_reassemble(&rx, &t, &tl, &d, &dl, 0, total));
+
+  CHECK(!fleet_dispatch(&table, routes, ROUTE_COUNT, "usf/logs/alerts", 15, message, total, 1));
+  CHECK(!fleet_dispatch(&table, routes, ROUTE_COUNT, "usf/unit/a/other", 16, message, total, 1));
+  CHECK_EQ(table.stats.unknown_topic, 2);
+
+  // Alarm level: the most severe class seen in the last FLEET_LEVEL_HOLD_US, not the newest
+  memset(&table, 0, sizeof(table));
+  const int64_t S = 1000000;
+  alert("lift-b", "red", "R02 - E-Stop is OFF", 100 * S);
+  alert("lift-b", "amber", "A16 - Flood waters - DOWN Locked", 102 * S);
+  alert("lift-b", "green", "G00 - No exceptions", 105 * S);
+  fleet_unit_t *lift = fleet_find(&table, "lift-b", 6, false);
+  CHECK(lift != nullptr);
+  if (lift) {
+    const char *code = nullptr;
+    CHECK_EQ(lift->alerts, 3);
+    CHECK_EQ(fleet_unit_level(lift, 106 * S, &code), FLEET_LEVEL_RED);
+    CHECK(std::string(code) == "R02");
+    CHECK_EQ(fleet_unit_level(lift, 100 * S + FLEET_LEVEL_HOLD_US, &code), FLEET_LEVEL_RED);
+    CHECK_EQ(fleet_unit_level(lift, 116 * S, &code), FLEET_LEVEL_AMBER);
+    CHECK(std::string(code) == "A16");
+    CHECK_EQ(fleet_unit_level(lift, 118 * S, &code), FLEET_LEVEL_GREEN);
+    CHECK_EQ(fleet_unit_level(lift, 121 * S, &code), FLEET_LEVEL_NONE);
+    CHECK(std::string(code).empty());
+
+    // A newer alert of a class replaces its code and restarts its hold
+    alert("lift-b", "red", "R31 - Out of Service (flood switch)", 130 * S);
+    CHECK_EQ(fleet_unit_level(lift, 131 * S, &code), FLEET_LEVEL_RED);
+    CHECK(std::string(code) == "R31");
+    CHECK_EQ(fleet_unit_level(lift, 131 * S, nullptr), FLEET_LEVEL_RED);
+  }
+  fleet_unit_t blank = {};
+  CHECK_EQ(fleet_unit_level(&blank, 0, nullptr), FLEET_LEVEL_NONE);
+
+  return testResult("FleetDispatchTest");
+}
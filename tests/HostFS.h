@@ -0,0 +1,87 @@
+// HostFS.h - The subset of the SPIFFS API the journals and the event store use, backed by
+// a host directory
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// A regular file, a directory being listed, or a directory entry (name only)
+class HostFile {
+ public:
+  HostFile() = default;
+  HostFile(FILE* file, bool failWrites) : file(file), failWrites(failWrites) {}
+  HostFile(DIR* dir) : dir(dir) {}
+  explicit HostFile(const std::string& entryName) : entryName(entryName) {}
+
+  explicit operator bool() const { return file || dir || !entryName.empty(); }
+  const char* name() const { return entryName.c_str(); }
+  size_t write(const uint8_t* data, size_t length) { return failWrites ? 0 : fwrite(data, 1, length, file); }
+  size_t read(uint8_t* data, size_t length) { return fread(data, 1, length, file); }
+  bool seek(uint32_t position) { return fseek(file, position, SEEK_SET) == 0; }
+  size_t position() const { return (size_t)ftell(file); }
+  size_t size() const {
+    long current = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    fseek(file, current, SEEK_SET);
+    return (size_t)end;
+  }
+  void flush() { fflush(file); }
+
+  HostFile openNextFile() {
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+      if (entry->d_name[0] != '.') return HostFile(std::string("/") + entry->d_name);
+    }
+    return HostFile();
+  }
+
+  void close() {
+    if (file) fclose(file);
+    if (dir) closedir(dir);
+    file = nullptr;
+    dir = nullptr;
+  }
+
+ private:
+  FILE* file = nullptr;
+  DIR* dir = nullptr;
+  std::string entryName;
+  bool failWrites = false;
+};
+
+// Files live in a fresh temporary directory; failWrites simulates a full flash
+class HostFS {
+ public:
+  bool failWrites = false;
+
+  HostFS() {
+    char pattern[] = "/tmp/hostfs.XXXXXX";
+    root = mkdtemp(pattern);
+  }
+  ~HostFS() { std::system(("rm -rf " + root).c_str()); }
+
+  HostFile open(const char* path, const char* mode = "r") {
+    struct stat info;
+    if (stat(hostPath(path).c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+      return HostFile(opendir(hostPath(path).c_str()));
+    }
+    std::string binaryMode = std::string(mode) + "b";
+    return HostFile(fopen(hostPath(path).c_str(), binaryMode.c_str()), failWrites);
+  }
+  bool exists(const char* path) { return access(hostPath(path).c_str(), F_OK) == 0; }
+  bool remove(const char* path) { return ::remove(hostPath(path).c_str()) == 0; }
+  bool rename(const char* from, const char* to) { return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0; }
+
+ private:
+  std::string root;
+  std::string hostPath(const char* path) const { return root + path; }
+};
+
+#endif // HOST_FS_H
@@ -0,0 +1,44 @@
+// Decode time per LED state: legacy chain plus description lookup vs the table decoder
+
+#include <vector>
+#include "TestUtil.h"
+#include "LegacyLEDChain.h"
+
+int main() {
+  const uint32_t ROUNDS = 20;
+  std::vector<LEDStateWord> states;
+  uint32_t seed = 12345;
+  for (uint32_t i = 0; i < 65536; i++) {
+    seed = seed * 1103515245u + 12345u;  // Shuffled so the branch predictor sees no pattern
+    states.push_back((LEDStateWord)(seed >> 8));
+  }
+  const double decodes = (double)ROUNDS * states.size();
+
+  uint64_t start = nowNs();
+  size_t legacyChars = 0;
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    for (LEDStateWord word : states) {
+      LegacyResult result = legacyDecode(word);
+      legacyChars += legacyDescription(result.red).size() + legacyDescription(result.green).size() +
+                     legacyDescription(result.amber).size();
+    }
+  }
+  double legacyNs = (nowNs() - start) / decodes;
+  keep(legacyChars);
+
+  start = nowNs();
+  uint32_t tableSum = 0;
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    for (LEDStateWord word : states) {
+      LEDAlarmResult result = decodeLEDAlarms(word);
+      tableSum += (uint32_t)result.red + (uint32_t)result.green + (uint32_t)result.amber + result.interlock +
+                  (uint32_t)(uintptr_t)alarmInfo(result.amber).description;
+    }
+  }
+  double tableNs = (nowNs() - start) / decodes;
+  keep(tableSum);
+
+  std::printf("legacy chain + descriptions: %7.1f ns/decode\n", legacyNs);
+  std::printf("table decoder:               %7.1f ns/decode (%.0fx)\n", tableNs, legacyNs / tableNs);
+  return 0;
+}
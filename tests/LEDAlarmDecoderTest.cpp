@@ -0,0 +1,43 @@
+// Walks every packed LED state and checks the table decoder against the legacy chain
+
+#include "TestUtil.h"
+#include "LegacyLEDChain.h"
+
+int main() {
+  uint32_t mismatches = 0;
+  for (uint32_t state = 0; state <= 0xFFFF; state++) {
+    LEDStateWord word = (LEDStateWord)state;
+    LegacyResult expected = legacyDecode(word);
+    LEDAlarmResult actual = decodeLEDAlarms(word);
+
+    bool same = expected.red == alarmInfo(actual.red).code &&
+                expected.green == alarmInfo(actual.green).code &&
+                expected.amber == alarmInfo(actual.amber).code &&
+                expected.interlock == actual.interlock;
+    if (!same && mismatches++ < 10) {
+      std::printf("state %04x: legacy %s/%s/%s %x, table %s/%s/%s %x\n", (unsigned)state,
+                  expected.red.c_str(), expected.green.c_str(), expected.amber.c_str(),
+                  expected.interlock, alarmInfo(actual.red).code, alarmInfo(actual.green).code,
+                  alarmInfo(actual.amber).code, actual.interlock);
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // Every code's description matches the old lookup
+  for (uint8_t code = 1; code < (uint8_t)AlarmCode::Count; code++) {
+    const AlarmInfo& info = alarmInfo((AlarmCode)code);
+    CHECK(legacyDescription(info.code) == info.description);
+  }
+  CHECK(legacyDescription("") == alarmInfo(AlarmCode::None).description);
+  CHECK(alarmInfo(AlarmCode::Count).code == alarmInfo(AlarmCode::None).code);
+
+  // Display states used in the status text
+  LEDStateWord word = packLEDState(0x1, 0x2, 0x4, 0x8);
+  CHECK_EQ(ledDisplayState(word, false, 0), 1);
+  CHECK_EQ(ledDisplayState(word, false, 1), 2);
+  CHECK_EQ(ledDisplayState(word, true, 2), 1);
+  CHECK_EQ(ledDisplayState(word, true, 3), 2);
+  CHECK_EQ(ledDisplayState(word, true, 0), 0);
+
+  return testResult("LEDAlarmDecoderTest");
+}
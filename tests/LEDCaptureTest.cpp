@@ -0,0 +1,72 @@
+// Drives the LED classifier with synthetic edge traces in virtual time
+
+#include "TestUtil.h"
+#include "LEDCapture.h"
+
+static const uint32_t TICK_US = 10000;  // ledCaptureTask period
+
+// Toggles one LED every halfPeriodUs for durationUs, updating every tick. Returns the
+// number of snapshots published and leaves the last one in snapshot.
+static uint32_t runFlash(LEDClassifier& classifier, uint8_t led, uint32_t halfPeriodUs,
+                         uint32_t durationUs, LEDSnapshot& snapshot) {
+  uint32_t published = 0;
+  uint8_t level = 0;
+  uint32_t nextEdgeUs = halfPeriodUs;
+  for (uint32_t now = 0; now <= durationUs; now += TICK_US) {
+    while (nextEdgeUs <= now) {
+      level ^= 1;
+      classifier.addEdge({nextEdgeUs, led, level});
+      nextEdgeUs += halfPeriodUs;
+    }
+    LEDSnapshot next;
+    if (classifier.update(now, next)) {
+      snapshot = next;
+      published++;
+    }
+  }
+  return published;
+}
+
+int main() {
+  const bool allOff[LED_CAPTURE_COUNT] = {};
+
+  // 1 Hz flash for 10 s: ON, OFF, then FLASHING once and nothing after that
+  LEDClassifier classifier;
+  classifier.begin(allOff, 0);
+  LEDSnapshot snapshot = {};
+  uint32_t published = runFlash(classifier, 0, 500000, 10000000, snapshot);
+  CHECK_EQ(published, 3);
+  CHECK(classifier.classOf(0) == LEDClass::Flashing);
+  CHECK_EQ(snapshot.word, packLEDState(0, 0x1, 0, 0));  // No ON bit while FLASHING
+  CHECK_EQ(snapshot.frequencyCentiHz[0], 100);
+  CHECK(classifier.getStats().maxFlashLatencyUs <= LED_FLASH_WINDOW_US);
+
+  // A green LED flashing at 2 Hz settles the same way
+  classifier.begin(allOff, 0);
+  published = runFlash(classifier, 5, 250000, 10000000, snapshot);
+  CHECK(published <= 3);
+  CHECK_EQ(snapshot.word, packLEDState(0, 0, 0, 0x2));
+  CHECK_EQ(snapshot.frequencyCentiHz[5], 200);
+
+  // A steady LED keeps its ON bit; a short glitch on it is cancelled
+  classifier.begin(allOff, 0);
+  classifier.addEdge({1000, 4, 1});
+  CHECK(!classifier.update(10000, snapshot));
+  CHECK(classifier.update(40000, snapshot));
+  CHECK_EQ(snapshot.word, packLEDState(0, 0, 0x1, 0));
+  classifier.addEdge({100000, 4, 0});
+  classifier.addEdge({100500, 4, 1});
+  CHECK(!classifier.update(200000, snapshot));
+  CHECK_EQ(classifier.getStats().glitches, 1);
+  CHECK(classifier.classOf(4) == LEDClass::On);
+
+  // Ring drops instead of overwriting when full
+  SPSCRing<LEDEdge, 4> ring;
+  for (uint8_t i = 0; i < 6; i++) ring.push({i, 0, 1});
+  CHECK_EQ(ring.size(), 4);
+  CHECK_EQ(ring.dropped(), 2);
+  LEDEdge edge;
+  CHECK(ring.pop(edge) && edge.timestampUs == 0);
+
+  return testResult("LEDCaptureTest");
+}
@@ -0,0 +1,236 @@
+// LegacyLEDChain.h - The if/else chain processLEDStatus() used before LEDAlarmDecoder.h
+//
+// Kept verbatim apart from String -> std::string and the side effects (emails, logging) so
+// the table decoder can be checked against it state by state and benchmarked against it.
+
+#ifndef LEGACY_LED_CHAIN_H
+#define LEGACY_LED_CHAIN_H
+
+#include <string>
+#include "LEDAlarmDecoder.h"
+
+struct LegacyResult {
+  std::string red;
+  std::string green;
+  std::string amber;
+  uint8_t interlock;
+};
+
+inline LegacyResult legacyDecode(LEDStateWord word) {
+  auto bit = [word](int shift, int i) { return ((word >> (shift + i)) & 1) != 0; };
+  bool r0 = bit(LED_RED_ON_SHIFT, 0), r1 = bit(LED_RED_ON_SHIFT, 1);
+  bool r2 = bit(LED_RED_ON_SHIFT, 2), r3 = bit(LED_RED_ON_SHIFT, 3);
+  bool g0 = bit(LED_GREEN_ON_SHIFT, 0), g1 = bit(LED_GREEN_ON_SHIFT, 1);
+  bool g2 = bit(LED_GREEN_ON_SHIFT, 2), g3 = bit(LED_GREEN_ON_SHIFT, 3);
+  bool r0f = bit(LED_RED_FLASH_SHIFT, 0), r1f = bit(LED_RED_FLASH_SHIFT, 1);
+  bool r2f = bit(LED_RED_FLASH_SHIFT, 2), r3f = bit(LED_RED_FLASH_SHIFT, 3);
+  bool g0f = bit(LED_GREEN_FLASH_SHIFT, 0), g1f = bit(LED_GREEN_FLASH_SHIFT, 1);
+  bool g2f = bit(LED_GREEN_FLASH_SHIFT, 2), g3f = bit(LED_GREEN_FLASH_SHIFT, 3);
+
+  LegacyResult result = {"", "", "", INTERLOCK_NONE};
+  auto stopUpMovement = [&result]() { result.interlock |= INTERLOCK_UP; };
+  auto stopDownMovement = [&result]() { result.interlock |= INTERLOCK_DOWN; };
+
+  bool a0 = r0 && g0;
+  bool a1 = r1 && g1;
+  bool a2 = r2 && g2;
+  bool a3 = r3 && g3;
+
+  bool a0f = (r0f && g0f) || (r0f && g0) || (r0 && g0f);
+  bool a1f = (r1f && g1f) || (r1f && g1) || (r1 && g1f);
+  bool a2f = (r2f && g2f) || (r2f && g2) || (r2 && g2f);
+  bool a3f = (r3f && g3f) || (r3f && g3) || (r3 && g3f);
+
+  bool anyGreenOn = g0 || g1 || g2 || g3;
+  bool anyRedFlashing = r0f || r1f || r2f || r3f;
+  bool anyAmberFlashing = a0f || a1f || a2f || a3f;
+
+  // RED ALARMS - Only if NO green LED is ON and NO amber is flashing
+  if (!anyGreenOn && !anyAmberFlashing) {
+    std::string alertName = "";
+    if (!r0 && !r1 && !r2 && !r3) {
+      alertName = "R01";
+    } else if (r0 && r1 && r2 && r3) {
+      alertName = "R02";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0 && r1 && r2 && !r3) {
+      alertName = "R15";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0 && r1 && !r2 && !r3) {
+      alertName = "R23";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0 && !r1 && r2 && r3) {
+      alertName = "R22";
+      stopUpMovement();
+      stopDownMovement();
+    }
+    if (!r0f && !r1f && !r2f && !r3f) {
+      alertName = "R00";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && r1f && !r2f && !r3f) {
+      alertName = "R31";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && r1f && r2f && r3f) {
+      alertName = "R36";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0f && !r1f && !r2f && !r3f) {
+      alertName = "R37";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && r1f && !r2f && r3f) {
+      alertName = "R07";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0f && r1f && r2f && r3f) {
+      alertName = "R03";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0f && !r1f && !r2f && r3f) {
+      alertName = "R27";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0f && r1f && r2f && !r3f) {
+      alertName = "R10";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && !r1f && r2f && !r3f) {
+      alertName = "R11";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && r1f && r2f && !r3f) {
+      alertName = "R12";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (r0f && !r1f && r2f && !r3f) {
+      alertName = "R13";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && !r1f && r2f && r3f) {
+      alertName = "R24";
+      stopUpMovement();
+      stopDownMovement();
+    } else if (!r0f && !r1f && !r2f && r3f) {
+      alertName = "R05";
+      stopUpMovement();
+      stopDownMovement();
+    }
+    result.red = alertName;
+  }
+
+  // GREEN ALARMS - Only if NO red LED is flashing
+  if (!anyRedFlashing) {
+    std::string alertName = "";
+    if (!g0 && !g1 && !g2 && !g3) {
+      alertName = "G01";
+    } else if (g0 && g1 && g2 && g3) {
+      alertName = "G00";
+    } else if (!g0f && !g1f && !g2f && !g3f) {
+      alertName = "G02";
+    } else if (g0f && g1f && g2f && !g3f) {
+      alertName = "G03";
+    } else if (g0f && g1f && g2f && g3f) {
+      alertName = "G04";
+    }
+    result.green = alertName;
+  }
+
+  // AMBER ALARMS (no mutual exclusion)
+  std::string alertName = "";
+  if (!a0 && !a1 && !a2 && !a3) {
+    alertName = "A01";
+  } else if (a0 && a1 && a2 && !a3) {
+    alertName = "A04";
+  } else if (!a0 && a1 && a2 && a3) {
+    alertName = "A39";
+  } else if (a0 && !a1 && !a2 && !a3) {
+    alertName = "A30";
+  } else if (!a0 && a1 && !a2 && !a3) {
+    alertName = "A33";
+  } else if (a0 && a1 && !a2 && !a3) {
+    alertName = "A34";
+  } else if (!a0 && !a1 && a2 && !a3) {
+    alertName = "A35";
+  } else if (!a0 && !a1 && a2 && a3) {
+    alertName = "A36";
+  } else if (a0 && !a1 && !a2 && a3) {
+    alertName = "A37";
+  }
+  if (!a0f && !a1f && !a2f && !a3f) {
+    alertName = "A02";
+  } else if (a0f && a1f && a2f && !a3f) {
+    alertName = "A32";
+    stopUpMovement();
+  } else if (!a0f && a1f && a2f && a3f) {
+    alertName = "A40";
+  } else if (!a0f && !a1f && a2f && !a3f) {
+    alertName = "A06";
+    stopUpMovement();
+  } else if (a0f && !a1f && !a2f && a3f) {
+    alertName = "A08";
+    stopUpMovement();
+  } else if (a0f && a1f && !a2f && !a3f) {
+    alertName = "A14";
+    stopDownMovement();
+  } else if (!a0f && a1f && !a2f && !a3f) {
+    alertName = "A16";
+    stopDownMovement();
+  } else if (!a0f && a1f && a2f && !a3f) {
+    alertName = "A38";
+  }
+  result.amber = alertName;
+
+  return result;
+}
+
+// The description lookup that followed the chain
+inline std::string legacyDescription(const std::string& alertCode) {
+  if (alertCode == "R01") return "All RED LEDs are OFF";
+  else if (alertCode == "R02") return "E-Stop is OFF";
+  else if (alertCode == "R15") return "OSG/Pit Switch activated";
+  else if (alertCode == "R23") return "Door Lock Failure";
+  else if (alertCode == "R22") return "Door Open";
+  else if (alertCode == "R00") return "No FLASHING RED LEDs";
+  else if (alertCode == "R31") return "Out of Service (flood switch)";
+  else if (alertCode == "R36") return "Out of Service – periodic maintenance";
+  else if (alertCode == "R37") return "Out of Service (travel time)";
+  else if (alertCode == "R07") return "Drive Train, Belt Failure";
+  else if (alertCode == "R03") return "Drive Nut Friction block fails";
+  else if (alertCode == "R27") return "Drive Train Alignment";
+  else if (alertCode == "R10") return "Final Limit";
+  else if (alertCode == "R11") return "Landing Switch (Top) failure";
+  else if (alertCode == "R12") return "Landing Switch (Mid) failure";
+  else if (alertCode == "R13") return "Landing Switch (Bottom) failure";
+  else if (alertCode == "R24") return "Drive Train Motor Failure";
+  else if (alertCode == "R05") return "Motor temperature failure";
+  else if (alertCode == "G01") return "All GREEN LEDs are OFF";
+  else if (alertCode == "G00") return "No exceptions";
+  else if (alertCode == "G02") return "No FLASHING GREEN LEDs";
+  else if (alertCode == "G03") return "On Battery Power";
+  else if (alertCode == "G04") return "Bypass Jumpers/Service Switch";
+  else if (alertCode == "A01") return "ALL AMBER LEDs OFF";
+  else if (alertCode == "A04") return "Power Failure";
+  else if (alertCode == "A39") return "Power Failure";
+  else if (alertCode == "A30") return "Service Required (Flood switch)";
+  else if (alertCode == "A33") return "Service Required – travel time";
+  else if (alertCode == "A34") return "Service Required – maintenance";
+  else if (alertCode == "A35") return "Service Required – hours";
+  else if (alertCode == "A36") return "Service Required – Battery";
+  else if (alertCode == "A37") return "Service Required - Inverter";
+  else if (alertCode == "A02") return "No FLASHING AMBER LEDs";
+  else if (alertCode == "A32") return "Power Failure - UP Locked";
+  else if (alertCode == "A40") return "Power Failure";
+  else if (alertCode == "A06") return "Motor Failure - UP Locked";
+  else if (alertCode == "A08") return "Anti-Rock binding - UP Locked";
+  else if (alertCode == "A14") return "Bottom Final Limit - DOWN Locked";
+  else if (alertCode == "A16") return "Flood waters - DOWN Locked";
+  else if (alertCode == "A38") return "Motor Temperature monitoring lost";
+  return "Unknown Alert Code";
+}
+
+#endif // LEGACY_LED_CHAIN_H
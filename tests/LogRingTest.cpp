@@ -0,0 +1,62 @@
+// Appends random-length lines to the HMI log ring and checks every retained line
+
+#include <string>
+#include <vector>
+#include "TestUtil.h"
+#include "LogRing.h"
+
+static log_ring_t ring;
+
+int main() {
+  log_ring_init(&ring);
+  CHECK_EQ(log_ring_count(&ring), 0);
+  CHECK(log_ring_line(&ring, 0, nullptr) == nullptr);
+
+  // Trailing newlines are stripped and long lines cut short
+  log_ring_append(&ring, "Moving up\r\n", 11, LOG_KIND_COMMAND);
+  uint8_t kind = 0;
+  CHECK(std::string(log_ring_line(&ring, 0, &kind)) == "Moving up");
+  CHECK_EQ(kind, LOG_KIND_COMMAND);
+  std::string longLine(400, 'x');
+  log_ring_append(&ring, longLine.c_str(), longLine.size(), LOG_KIND_INFO);
+  CHECK_EQ(std::string(log_ring_line(&ring, 1, nullptr)).size(), LOG_LINE_MAX - 1);
+
+  // Random lengths: both the index and the text buffer wrap many times
+  std::vector<std::string> appended = {"Moving up", longLine.substr(0, LOG_LINE_MAX - 1)};
+  uint32_t seed = 7;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245u + 12345u;
+    size_t length = (seed >> 16) % (i % 3 == 0 ? 150 : 20);
+    std::string line = "#" + std::to_string(i) + ' ' + std::string(length, (char)('a' + i % 26));
+    if (line.size() > LOG_LINE_MAX - 1) line.resize(LOG_LINE_MAX - 1);
+    log_ring_append(&ring, line.c_str(), line.size(), (uint8_t)(i % LOG_KIND_COUNT));
+    appended.push_back(line);
+
+    uint32_t count = log_ring_count(&ring);
+    CHECK(count >= 1 && count <= LOG_RING_LINES);
+    CHECK_EQ(ring.next_line, appended.size());
+    CHECK_EQ(ring.first_line, ring.dropped);
+  }
+
+  uint32_t mismatches = 0;
+  size_t textBytes = 0;
+  for (uint32_t line = ring.first_line; line < ring.next_line; line++) {
+    const char* text = log_ring_line(&ring, line, &kind);
+    if (!text || appended[line] != text) mismatches++;
+    else textBytes += strlen(text) + 1;
+  }
+  CHECK_EQ(mismatches, 0);
+  CHECK(textBytes <= LOG_RING_TEXT_BYTES);
+  CHECK(log_ring_line(&ring, ring.first_line - 1, nullptr) == nullptr);
+  CHECK(log_ring_line(&ring, ring.next_line, nullptr) == nullptr);
+
+  // Short lines are limited by the index, long ones by the text buffer
+  log_ring_init(&ring);
+  for (int i = 0; i < 1000; i++) log_ring_append(&ring, "ok", 2, LOG_KIND_INFO);
+  CHECK_EQ(log_ring_count(&ring), LOG_RING_LINES);
+  log_ring_init(&ring);
+  for (int i = 0; i < 1000; i++) log_ring_append(&ring, longLine.c_str(), longLine.size(), LOG_KIND_INFO);
+  CHECK(log_ring_count(&ring) >= LOG_RING_TEXT_BYTES / LOG_LINE_MAX - 1);
+
+  return testResult("LogRingTest");
+}
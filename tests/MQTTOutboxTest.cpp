@@ -0,0 +1,145 @@
+// Broker outage, journal reload after a reboot, boot counting and partly failed publishes,
+// against a host directory
+
+#include <string>
+#include <vector>
+#include "TestUtil.h"
+#include "HostFS.h"
+#include "MQTTOutbox.h"
+
+// A broker that can go away: publishes fail while it is down, or for one topic
+struct FakeBroker {
+  bool up = true;
+  const char* downTopic = nullptr;
+  std::vector<std::string> received;
+  std::vector<std::string> topics;
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+    if (!up || (downTopic && strcmp(topic, downTopic) == 0)) return false;
+    received.push_back(std::string((const char*)payload, length));
+    topics.push_back(topic);
+    return true;
+  }
+};
+
+static MQTTPayload payload;
+static OutboxJournalBatch batch;
+
+static void queueEvent(MQTTOutbox& outbox, uint32_t bootId, OutboxPriority priority, const char* message) {
+  uint32_t seq = outbox.nextSequence();
+  payload.begin();
+  payload.addUnsigned("boot", bootId);
+  payload.addUnsigned("seq", seq);
+  payload.add("message", message);
+  payload.finish();
+  outbox.enqueue(seq, priority, 1, priority != OutboxPriority::Info, payload.c_str(), payload.length());
+}
+
+// One MQTT task iteration: drain while the broker takes messages, then sync the journal
+static void runMqttTask(MQTTOutbox& outbox, FakeBroker& broker, HostFS& fs) {
+  static OutboxEntry entry;
+  static const char* const topics[] = {"usf/logs/alerts"};
+  while (outbox.peek(entry) && MQTTPayload::publish(broker, topics, 1, entry.payload, entry.length) == 1) {
+    outbox.acknowledge(entry.sequence);
+  }
+  outbox.sync(fs, batch);
+}
+
+int main() {
+  HostFS fs;
+  FakeBroker broker;
+
+  // Boot 1: the broker dies after the first event, 30 more are queued while it is down
+  uint32_t boot = advanceBootCount(fs);
+  CHECK_EQ(boot, 1);
+  static MQTTOutbox outbox;
+  queueEvent(outbox, boot, OutboxPriority::Red, "before outage");
+  runMqttTask(outbox, broker, fs);
+  CHECK_EQ(broker.received.size(), 1);
+
+  broker.up = false;
+  for (int i = 0; i < 30; i++) {
+    queueEvent(outbox, boot, i % 3 == 0 ? OutboxPriority::Red : OutboxPriority::Info, "during outage");
+    runMqttTask(outbox, broker, fs);
+  }
+  uint32_t reds = 10;
+  CHECK_EQ(outbox.depth(), MQTT_OUTBOX_CAPACITY);
+  CHECK(broker.received.size() == 1);
+
+  // Reset while the broker is still down: only journaled (non-Info) entries come back
+  boot = advanceBootCount(fs);
+  CHECK_EQ(boot, 2);
+  static MQTTOutbox rebooted;
+  rebooted.load(fs);
+  CHECK_EQ(rebooted.depth(), reds);
+  uint32_t restartSeq = rebooted.nextSequence();
+  CHECK_EQ(restartSeq, 30);  // Continues after the last replayed entry
+
+  // Broker back: the backlog arrives once, in order, then new events with the new boot
+  broker.up = true;
+  broker.received.clear();
+  queueEvent(rebooted, boot, OutboxPriority::Amber, "after reboot");
+  runMqttTask(rebooted, broker, fs);
+  CHECK_EQ(broker.received.size(), reds + 1);
+  CHECK(broker.received[0].find("\"boot\":1,\"seq\":2,") != std::string::npos);
+  CHECK(broker.received[reds].find("\"boot\":2,") != std::string::npos);
+  CHECK_EQ(rebooted.getStats().replayed, reds);
+  CHECK(rebooted.empty());
+
+  // Nothing is replayed again after a second reset; seq restarts but boot tells them apart
+  boot = advanceBootCount(fs);
+  static MQTTOutbox thirdBoot;
+  thirdBoot.load(fs);
+  CHECK(thirdBoot.empty());
+  CHECK_EQ(thirdBoot.nextSequence(), 1);
+  CHECK_EQ(boot, 3);
+
+  // Entries acknowledged between prepareSync() and finishSync() are not replayed
+  queueEvent(thirdBoot, boot, OutboxPriority::Red, "a");
+  queueEvent(thirdBoot, boot, OutboxPriority::Red, "b");
+  thirdBoot.sync(fs, batch);  // Compaction requested by load()
+  queueEvent(thirdBoot, boot, OutboxPriority::Red, "c");
+  CHECK(thirdBoot.prepareSync(batch));
+  thirdBoot.acknowledge(2);
+  thirdBoot.acknowledge(3);
+  size_t bytes;
+  bool written = MQTTOutbox::writeSync(fs, batch, bytes);
+  thirdBoot.finishSync(batch, written, bytes);
+  thirdBoot.sync(fs, batch);  // ACK records
+  static MQTTOutbox fourthBoot;
+  fourthBoot.load(fs);
+  CHECK_EQ(fourthBoot.depth(), 1);
+
+  // A failed write rewrites the whole journal on the next sync
+  fs.failWrites = true;
+  queueEvent(fourthBoot, boot, OutboxPriority::Red, "d");
+  CHECK(!fourthBoot.sync(fs, batch));
+  fs.failWrites = false;
+  uint32_t compactions = fourthBoot.getStats().compactions;
+  CHECK(fourthBoot.sync(fs, batch));
+  CHECK_EQ(fourthBoot.getStats().compactions, compactions + 1);
+  static MQTTOutbox fifthBoot;
+  fifthBoot.load(fs);
+  CHECK_EQ(fifthBoot.depth(), 2);
+
+  // An entry that reached only some of its topics is retried on the others only
+  static MQTTOutbox partial;
+  static OutboxEntry entry;
+  const char* const unitAndLegacy[] = {"usf/unit/lift-a/logs/alerts", "usf/logs/alerts"};
+  queueEvent(partial, boot, OutboxPriority::Red, "partial");
+  broker.received.clear();
+  broker.topics.clear();
+  broker.downTopic = unitAndLegacy[1];
+  CHECK(partial.peek(entry));
+  uint16_t published = entry.published;
+  CHECK_EQ(MQTTPayload::publish(broker, unitAndLegacy, 2, entry.payload, entry.length, published), 1);
+  partial.markPublished(entry.sequence, published);
+  broker.downTopic = nullptr;
+  CHECK(partial.peek(entry));
+  CHECK_EQ(entry.published, 1);
+  published = entry.published;
+  CHECK_EQ(MQTTPayload::publish(broker, unitAndLegacy, 2, entry.payload, entry.length, published), 1);
+  CHECK_EQ(published, 3);
+  CHECK(broker.topics == std::vector<std::string>({unitAndLegacy[0], unitAndLegacy[1]}));
+
+  return testResult("MQTTOutboxTest");
+}
@@ -0,0 +1,88 @@
+// Heap allocations and ns per alert event: the String concatenation publishAlert() used
+// before MQTTPayload.h versus one fixed-buffer encoding fanned out to both topics.
+//
+// std::string keeps short strings inline, so the legacy counts here are a lower bound for
+// Arduino String on the ESP32.
+
+#include <cstring>
+#include <string>
+#include "AllocCounter.h"
+#include "TestUtil.h"
+#include "MQTTPayload.h"
+
+struct NullClient {
+  size_t bytes = 0;
+  bool publish(const char*, const uint8_t*, unsigned int length) {
+    bytes += length;
+    return true;
+  }
+  bool publish(const char*, const char* payload) {
+    bytes += strlen(payload);
+    return true;
+  }
+};
+
+static std::string getTimestamp() {
+  char timeStringBuff[50];
+  snprintf(timeStringBuff, sizeof(timeStringBuff), "%s", "2025-06-01 12:00:00");
+  return std::string(timeStringBuff);
+}
+
+static const bool redStates[4] = {true, true, true, true};
+static const bool greenStates[4] = {false, false, false, false};
+
+// publishAlert() before MQTTPayload.h, with String -> std::string
+static void legacyPublishAlert(NullClient& client, const char* level, const std::string& msg) {
+  std::string ledCode = "";
+  for (int i = 0; i < 4; i++) ledCode += std::string(redStates[i] ? "1" : "0");
+  ledCode += "-";
+  for (int i = 0; i < 4; i++) ledCode += std::string(greenStates[i] ? "1" : "0");
+
+  std::string alertPayload = "{\"type\":\"" + std::string(level) + "\",\"message\":\"" + msg +
+                             "\",\"led_code\":\"" + ledCode + "\",\"timestamp\":\"" + getTimestamp() + "\"}";
+  std::string generalPayload = "{\"type\":\"alert\",\"alert_type\":\"" + std::string(level) +
+                               "\",\"message\":\"" + msg + "\",\"led_code\":\"" + ledCode +
+                               "\",\"timestamp\":\"" + getTimestamp() + "\"}";
+  client.publish("usf/logs/alerts", alertPayload.c_str());
+  client.publish("usf/logs/general", generalPayload.c_str());
+}
+
+static MQTTPayload payload;
+
+static void payloadPublishAlert(NullClient& client, uint32_t seq, const char* level, const char* msg) {
+  char timestamp[32];
+  snprintf(timestamp, sizeof(timestamp), "%s", "2025-06-01 12:00:00");
+  payload.begin();
+  payload.addUnsigned("seq", seq);
+  payload.add("type", level);
+  payload.add("alert_type", level);
+  payload.add("message", msg);
+  payload.add("led_code", "1111-0000");
+  payload.add("timestamp", timestamp);
+  payload.finish();
+  static const char* const topics[] = {"usf/logs/alerts", "usf/logs/general"};
+  payload.recordPublishes(MQTTPayload::publish(client, topics, 2, payload.c_str(), payload.length()), 0);
+}
+
+int main() {
+  const uint32_t EVENTS = 200000;
+  const std::string message = "R02 - E-Stop is OFF while the platform was travelling up";
+  NullClient client;
+
+  uint64_t allocations = heapAllocations;
+  uint64_t start = nowNs();
+  for (uint32_t i = 0; i < EVENTS; i++) legacyPublishAlert(client, "red", message);
+  double legacyNs = (double)(nowNs() - start) / EVENTS;
+  double legacyAllocs = (double)(heapAllocations - allocations) / EVENTS;
+
+  allocations = heapAllocations;
+  start = nowNs();
+  for (uint32_t i = 0; i < EVENTS; i++) payloadPublishAlert(client, i, "red", message.c_str());
+  double payloadNs = (double)(nowNs() - start) / EVENTS;
+  double payloadAllocs = (double)(heapAllocations - allocations) / EVENTS;
+  keep(client.bytes);
+
+  std::printf("String concatenation: %6.1f ns/event, %5.1f allocations/event\n", legacyNs, legacyAllocs);
+  std::printf("MQTTPayload:          %6.1f ns/event, %5.1f allocations/event\n", payloadNs, payloadAllocs);
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Escaping, truncation, unsigned counters and heap use of the MQTT payload serializer
+
+#include <string>
+#include <vector>
+#include "AllocCounter.h"
+#include "TestUtil.h"
+#include "MQTTPayload.h"
+
+struct RecordingClient {
+  std::vector<std::string> topics;
+  bool fail = false;
+  bool publish(const char* topic, const uint8_t*, unsigned int) {
+    if (fail) return false;
+    topics.push_back(topic);
+    return true;
+  }
+};
+
+static MQTTPayload payload;  // 0.5 KB buffer, static like mqttPayload in the sketch
+
+int main() {
+  payload.begin();
+  payload.add("message", "quote \" backslash \\ newline \n tab \t bell \x07");
+  payload.addNumber("signed", -5);
+  payload.addUnsigned("counter", 3000000000u);
+  payload.addBool("ok", true);
+  payload.finish();
+  CHECK(std::string(payload.c_str()) ==
+        "{\"message\":\"quote \\\" backslash \\\\ newline \\n tab \\t bell \\u0007\","
+        "\"signed\":-5,\"counter\":3000000000,\"ok\":true}");
+  CHECK(!payload.overflowed());
+
+  // A value that does not fit is cut short on a UTF-8 boundary and the object stays closed
+  std::string longText;
+  for (int i = 0; i < 300; i++) longText += "\xC3\xA9";  // é
+  payload.begin();
+  payload.add("message", longText.c_str());
+  payload.addUnsigned("after", 1);
+  const char* json = payload.finish();
+  size_t length = payload.length();
+  CHECK(payload.overflowed());
+  CHECK(length < MQTT_PAYLOAD_BUFFER_SIZE);
+  CHECK(json[length - 1] == '}' && json[length - 2] == '"');
+  CHECK(((unsigned char)json[length - 3] & 0xC0) == 0x80);  // Ends on a complete é
+  CHECK_EQ(payload.getStats().truncated, 1);
+
+  // One encoding to several topics; the counters only move through recordPublishes()
+  RecordingClient client;
+  const char* topics[] = {"usf/logs/alerts", "usf/logs/general"};
+  CHECK_EQ(MQTTPayload::publish(client, topics, 2, payload.c_str(), payload.length()), 2);
+  CHECK_EQ(client.topics.size(), 2);
+  CHECK_EQ(payload.getStats().publishes, 0);
+  payload.recordPublishes(2, 0);
+  client.fail = true;
+  CHECK_EQ(MQTTPayload::publish(client, topics, 2, payload.c_str(), payload.length()), 0);
+  payload.recordPublishes(0, 2);
+  CHECK_EQ(payload.getStats().publishes, 2);
+  CHECK_EQ(payload.getStats().publishFailures, 2);
+
+  // Serializing an event never touches the heap
+  client.fail = false;
+  client.topics.reserve(4000);
+  uint64_t before = heapAllocations;
+  for (uint32_t i = 0; i < 1000; i++) {
+    payload.begin();
+    payload.addUnsigned("seq", i);
+    payload.add("type", "red");
+    payload.add("alert_type", "red");
+    payload.add("message", "R02 - E-Stop is OFF");
+    payload.add("led_code", "1111-0000");
+    payload.add("timestamp", "2025-06-01 12:00:00");
+    payload.finish();
+  }
+  CHECK_EQ(heapAllocations - before, 0);
+
+  return testResult("MQTTPayloadTest");
+}
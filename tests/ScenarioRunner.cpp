@@ -0,0 +1,442 @@
+// Replays a scripted LED, button and command timeline through the controller logic in
+// virtual time and checks the resulting metrics against the expectations stored in the
+// scenario. Usage: ScenarioRunner <scenario.txt>
+//
+// The pipeline mirrors the sketch: edges go through the capture ring, ledCaptureTask
+// classifies every LED_CLASSIFY_PERIOD_MS, loop() runs every millisecond and commandTask
+// preempts it whenever a command is queued. Both tasks call the sketch's own code from
+// ControllerLogic.h (LEDAlarmHandler, LEDStatusText, ButtonPanel, RelayPair); only the
+// pins, the clock and the MQTT/log side of the alarm outputs are simulated. A task that
+// waits in a relay dead time is blocked in virtual time until it ends.
+//
+// Scenario lines (times in ms, in time order; # starts a comment):
+//   init <red bits> <green bits>          LED levels at t=0, e.g. "init 0000 1111"
+//   led <t> <r0..r3|g0..g3> <0|1>         one edge
+//   flash <from> <to> <led> <period>      toggles every half period, ends at the start level
+//   pulses <t> <led> <count> <width_us> <gap_us>   short pulses, e.g. a flicker storm
+//   button <t> <up|down> <press|release>
+//   command <t> <up|down|stop>            command frame executed by commandTask
+//   end <t>
+//   expect <metric> <<=|>=|==> <value>    the stored baseline for this scenario
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "TestUtil.h"
+#include "AllocCounter.h"
+#include "LEDCapture.h"
+#include "ControllerLogic.h"
+
+static const uint32_t LOOP_PERIOD_US = 1000;
+static const uint32_t CLASSIFY_PERIOD_US = 5000;   // LED_CLASSIFY_PERIOD_MS
+static const size_t COMMAND_QUEUE_LENGTH = 8;      // As in the sketch
+
+enum class ActionKind : uint8_t { Edge, Button, Command };
+
+struct Action {
+  uint64_t atUs;
+  ActionKind kind;
+  uint8_t target;  // LED index, 0 up / 1 down, or command
+  uint8_t value;   // Level, or 1 pressed
+};
+
+struct Expectation {
+  std::string metric;
+  std::string op;
+  long long value;
+  int line;
+};
+
+struct Scenario {
+  bool levels[LED_CAPTURE_COUNT] = {};
+  std::vector<Action> actions;
+  std::vector<Expectation> expectations;
+  uint64_t endUs = 0;
+};
+
+static int ledIndex(const std::string& name) {
+  if (name.size() != 2 || name[1] < '0' || name[1] > '3') return -1;
+  if (name[0] == 'r') return name[1] - '0';
+  if (name[0] == 'g') return 4 + (name[1] - '0');
+  return -1;
+}
+
+static uint64_t msToUs(double ms) {
+  return (uint64_t)(ms * 1000.0 + 0.5);
+}
+
+static bool parseScenario(const char* path, Scenario& scenario) {
+  std::ifstream file(path);
+  if (!file) {
+    std::printf("%s: cannot open\n", path);
+    return false;
+  }
+  bool level[LED_CAPTURE_COUNT] = {};
+  std::string text;
+  for (int lineNumber = 1; std::getline(file, text); lineNumber++) {
+    size_t comment = text.find('#');
+    if (comment != std::string::npos) text.resize(comment);
+    std::istringstream line(text);
+    std::string word;
+    if (!(line >> word)) continue;
+
+    bool ok = true;
+    if (word == "init") {
+      std::string red, green;
+      ok = (line >> red >> green) && red.size() == 4 && green.size() == 4;
+      for (int i = 0; ok && i < 4; i++) {
+        scenario.levels[i] = level[i] = red[i] == '1';
+        scenario.levels[4 + i] = level[4 + i] = green[i] == '1';
+      }
+    } else if (word == "led") {
+      double t;
+      std::string name;
+      int value;
+      ok = (line >> t >> name >> value) && ledIndex(name) >= 0;
+      if (ok) {
+        int led = ledIndex(name);
+        level[led] = value != 0;
+        scenario.actions.push_back({msToUs(t), ActionKind::Edge, (uint8_t)led, (uint8_t)level[led]});
+      }
+    } else if (word == "flash") {
+      double from, to, period;
+      std::string name;
+      ok = (line >> from >> to >> name >> period) && ledIndex(name) >= 0 && period > 0 && to > from;
+      if (ok) {
+        int led = ledIndex(name);
+        bool startLevel = level[led];
+        for (uint64_t t = msToUs(from); t < msToUs(to); t += msToUs(period / 2)) {
+          level[led] = !level[led];
+          scenario.actions.push_back({t, ActionKind::Edge, (uint8_t)led, (uint8_t)level[led]});
+        }
+        if (level[led] != startLevel) {
+          level[led] = startLevel;
+          scenario.actions.push_back({msToUs(to), ActionKind::Edge, (uint8_t)led, (uint8_t)level[led]});
+        }
+      }
+    } else if (word == "pulses") {
+      double t;
+      std::string name;
+      unsigned count, widthUs, gapUs;
+      ok = (line >> t >> name >> count >> widthUs >> gapUs) && ledIndex(name) >= 0;
+      if (ok) {
+        int led = ledIndex(name);
+        uint64_t at = msToUs(t);
+        for (unsigned i = 0; i < count; i++, at += widthUs + gapUs) {
+          scenario.actions.push_back({at, ActionKind::Edge, (uint8_t)led, (uint8_t)!level[led]});
+          scenario.actions.push_back({at + widthUs, ActionKind::Edge, (uint8_t)led, (uint8_t)level[led]});
+        }
+      }
+    } else if (word == "button") {
+      double t;
+      std::string which, state;
+      ok = (line >> t >> which >> state) && (which == "up" || which == "down") &&
+           (state == "press" || state == "release");
+      if (ok) {
+        scenario.actions.push_back({msToUs(t), ActionKind::Button, (uint8_t)(which == "down"),
+                                    (uint8_t)(state == "press")});
+      }
+    } else if (word == "command") {
+      double t;
+      std::string op;
+      ok = (line >> t >> op) && (op == "up" || op == "down" || op == "stop");
+      if (ok) {
+        uint8_t command = op == "up" ? CMD_OP_UP : op == "down" ? CMD_OP_DOWN : CMD_OP_STOP;
+        scenario.actions.push_back({msToUs(t), ActionKind::Command, command, 0});
+      }
+    } else if (word == "end") {
+      double t;
+      ok = (bool)(line >> t);
+      if (ok) scenario.endUs = msToUs(t);
+    } else if (word == "expect") {
+      Expectation expectation;
+      ok = (line >> expectation.metric >> expectation.op >> expectation.value) &&
+           (expectation.op == "<=" || expectation.op == ">=" || expectation.op == "==");
+      expectation.line = lineNumber;
+      if (ok) scenario.expectations.push_back(expectation);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::printf("%s:%d: cannot parse \"%s\"\n", path, lineNumber, text.c_str());
+      return false;
+    }
+  }
+  std::stable_sort(scenario.actions.begin(), scenario.actions.end(),
+                   [](const Action& a, const Action& b) { return a.atUs < b.atUs; });
+  if (scenario.endUs == 0 && !scenario.actions.empty()) scenario.endUs = scenario.actions.back().atUs + 5000000;
+  return true;
+}
+
+// ===== Simulated controller ===== //
+
+// The relay outputs as the sketch wires them: UP_PIN/DOWN_PIN for the buttons,
+// UP_OUTPUT_PIN/DOWN_OUTPUT_PIN for commands
+enum SimPin : uint8_t { BUTTON_UP, BUTTON_DOWN, COMMAND_UP, COMMAND_DOWN, PIN_COUNT };
+
+// Pin levels over virtual time: how long each pin was on, and how long both pins of a pair
+struct SimPins {
+  bool level[PIN_COUNT] = {};
+  uint64_t sinceUs[PIN_COUNT] = {};
+  uint64_t onUs[PIN_COUNT] = {};
+  uint64_t overlapUs = 0;
+
+  void set(uint8_t pin, bool on, uint64_t atUs) {
+    if (level[pin] == on) return;
+    uint8_t other = pin ^ 1;
+    if (level[pin]) {
+      onUs[pin] += atUs - sinceUs[pin];
+      if (level[other]) overlapUs += atUs - std::max(sinceUs[pin], sinceUs[other]);
+    }
+    level[pin] = on;
+    sinceUs[pin] = atUs;
+  }
+
+  void finish(uint64_t atUs) {
+    for (uint8_t pin = 0; pin < PIN_COUNT; pin++) set(pin, false, atUs);
+  }
+};
+
+// RelayPair's pins and clock for one task; wait() blocks the task in virtual time
+struct SimRelays {
+  SimPins& pins;
+  uint64_t clockUs = 0;
+
+  explicit SimRelays(SimPins& pins) : pins(pins) {}
+  void write(uint8_t pin, bool on) { pins.set(pin, on, clockUs); }
+  void wait(uint32_t us) { clockUs += us; }
+  uint32_t nowUs() { return (uint32_t)clockUs; }
+};
+
+// commandQueue: commands at the back, interlock stops at the front
+struct SimCommand {
+  uint8_t opcode;
+  bool interlock;
+  uint64_t postedUs;
+  uint64_t alarmSinceUs;  // Interlocks: when the LED change began
+};
+
+class SimCommandQueue {
+ public:
+  bool pushBack(const SimCommand& command) {
+    if (count == COMMAND_QUEUE_LENGTH) return false;
+    entries[(head + count++) % COMMAND_QUEUE_LENGTH] = command;
+    return true;
+  }
+  bool pushFront(const SimCommand& command) {
+    if (count == COMMAND_QUEUE_LENGTH) return false;
+    head = (head + COMMAND_QUEUE_LENGTH - 1) % COMMAND_QUEUE_LENGTH;
+    entries[head] = command;
+    count++;
+    return true;
+  }
+  bool pop(SimCommand& command) {
+    if (count == 0) return false;
+    command = entries[head];
+    head = (head + 1) % COMMAND_QUEUE_LENGTH;
+    count--;
+    return true;
+  }
+
+ private:
+  SimCommand entries[COMMAND_QUEUE_LENGTH];
+  size_t head = 0;
+  size_t count = 0;
+};
+
+class SimController {
+ public:
+  std::map<std::string, long long> metrics;
+
+  explicit SimController(const Scenario& scenario) : scenario(scenario) {}
+
+  void run() {
+    classifier.begin(scenario.levels, 0);
+    size_t next = 0;
+    uint64_t hostNs = 0, hostMaxNs = 0, iterations = 0;
+    uint64_t allocations = 0;
+
+    for (uint64_t nowUs = LOOP_PERIOD_US; nowUs <= scenario.endUs; nowUs += LOOP_PERIOD_US) {
+      // Edges reach the ring at their own time (the ISR); buttons and commands at the tick
+      uint64_t allocationsBefore = heapAllocations;
+      for (; next < scenario.actions.size() && scenario.actions[next].atUs <= nowUs; next++) {
+        const Action& action = scenario.actions[next];
+        if (action.kind == ActionKind::Edge) {
+          edgeRing.push({(uint32_t)action.atUs, action.target, action.value});
+        } else if (action.kind == ActionKind::Button) {
+          buttonReading[action.target] = !action.value;  // Active low
+        } else if (!commands.pushBack({action.target, false, nowUs, 0})) {
+          commandDrops++;
+        }
+      }
+      commandTask(nowUs);
+      if (nowUs % CLASSIFY_PERIOD_US == 0) captureTask((uint32_t)nowUs);
+      allocations += heapAllocations - allocationsBefore;
+
+      // loop() does not run while it waits in a button relay dead time
+      if (nowUs < loopRelays.clockUs) continue;
+      allocationsBefore = heapAllocations;
+      uint64_t start = nowNs();
+      loopIteration(nowUs);
+      uint64_t elapsed = nowNs() - start;
+      allocations += heapAllocations - allocationsBefore;
+      hostNs += elapsed;
+      hostMaxNs = std::max(hostMaxNs, elapsed);
+      iterations++;
+      loopStats.record((uint32_t)(elapsed / 1000), (uint32_t)(nowUs / 1000));
+    }
+    pins.finish(scenario.endUs);
+
+    const LEDCaptureStats& capture = classifier.getStats();
+    metrics["edges"] = capture.edges;
+    metrics["edges_dropped"] = edgeRing.dropped();
+    metrics["glitches"] = capture.glitches;
+    metrics["snapshots"] = capture.snapshots;
+    metrics["detect_max_us"] = capture.maxDetectionLatencyUs;
+    metrics["flash_detect_max_us"] = capture.maxFlashLatencyUs;
+    metrics["alerts"] = alerts;
+    for (uint8_t code = 1; code < (uint8_t)AlarmCode::Count; code++) {
+      if (firstAlertMs[code]) metrics[std::string("alert_") + alarmInfo((AlarmCode)code).code + "_ms"] = firstAlertMs[code];
+    }
+    metrics["interlock_stops"] = interlockStops;
+    metrics["stop_latency_max_us"] = stopLatencyMaxUs;
+    metrics["moving_up_ms"] = (pins.onUs[BUTTON_UP] + pins.onUs[COMMAND_UP]) / 1000;
+    metrics["moving_down_ms"] = (pins.onUs[BUTTON_DOWN] + pins.onUs[COMMAND_DOWN]) / 1000;
+    metrics["command_drops"] = commandDrops;
+    metrics["relay_reversals"] = relayGaps.reversals;
+    metrics["relay_min_gap_us"] = relayGaps.minGapUs;
+    metrics["relay_max_gap_us"] = relayGaps.maxGapUs;
+    metrics["relay_overlap_us"] = pins.overlapUs;
+    metrics["loop_iterations"] = iterations;
+    metrics["iterations_per_s"] = loopStats.iterationsPerSecond();
+    metrics["loop_mean_ns"] = iterations ? hostNs / iterations : 0;
+    metrics["loop_max_ns"] = hostMaxNs;
+    metrics["heap_allocations"] = allocations;
+  }
+
+  // LEDAlarmHandler outputs, called from loop(). As in the sketch, the button outputs are
+  // released here and the command outputs by a stop at the front of commandQueue, which
+  // commandTask runs at once since it preempts loop().
+  void interlock(uint8_t flags) {
+    uint64_t nowUs = loopRelays.clockUs;
+    if (buttonRelays.release(flags)) recordInterlockStop(nowUs, alarmSinceUs);
+    uint8_t opcode = commandRelays.releaseOpcode(flags);
+    if (!opcode) return;
+    if (!commands.pushFront({opcode, true, nowUs, alarmSinceUs})) commandDrops++;
+    commandTask(nowUs);
+  }
+
+  void alert(AlarmCode code) {
+    alerts++;
+    if (firstAlertMs[(uint8_t)code] == 0) firstAlertMs[(uint8_t)code] = loopMs;
+  }
+
+ private:
+  const Scenario& scenario;
+  SPSCRing<LEDEdge, 256> edgeRing;
+  SPSCRing<LEDSnapshot, 16> snapshotRing;
+  LEDClassifier classifier;
+  SimPins pins;
+  SimRelays loopRelays{pins};
+  SimRelays commandTaskRelays{pins};
+  RelayPair<SimRelays> buttonRelays{loopRelays, BUTTON_UP, BUTTON_DOWN, RELAY_REVERSE_DEADTIME_US};
+  RelayPair<SimRelays> commandRelays{commandTaskRelays, COMMAND_UP, COMMAND_DOWN, RELAY_REVERSE_DEADTIME_US};
+  SimCommandQueue commands;
+  LEDAlarmHandler ledAlarms;
+  LEDStatusText ledStatusText;
+  ButtonPanel buttonPanel{BUTTON_DEBOUNCE_MS};
+  bool buttonReading[2] = {true, true};
+  uint32_t loopMs = 0;
+  uint64_t alarmSinceUs = 0;  // First edge of the LED change being applied
+  InterlockStats relayGaps = {};
+  LoopStats loopStats;
+  uint32_t alerts = 0;
+  uint32_t commandDrops = 0;
+  uint32_t interlockStops = 0;
+  uint32_t stopLatencyMaxUs = 0;
+  uint32_t firstAlertMs[(uint8_t)AlarmCode::Count] = {};  // 0 until the code is published
+
+  void recordInterlockStop(uint64_t atUs, uint64_t sinceUs) {
+    interlockStops++;
+    stopLatencyMaxUs = std::max(stopLatencyMaxUs, (uint32_t)(atUs - sinceUs));
+  }
+
+  void captureTask(uint32_t nowUs) {
+    LEDEdge edge;
+    while (edgeRing.pop(edge)) classifier.addEdge(edge);
+    LEDSnapshot snapshot;
+    if (classifier.update(nowUs, snapshot)) snapshotRing.push(snapshot);
+  }
+
+  // commandTask: takes the next command once it is posted and the task is not waiting in a
+  // reversal dead time, then executeCommand()
+  void commandTask(uint64_t nowUs) {
+    SimCommand command;
+    while (commandTaskRelays.clockUs <= nowUs && commands.pop(command)) {
+      commandTaskRelays.clockUs = std::max(commandTaskRelays.clockUs, command.postedUs);
+      uint32_t gapUs;
+      commandRelays.execute(command.opcode, gapUs);
+      if (gapUs) relayGaps.record(gapUs);
+      if (command.interlock) recordInterlockStop(commandTaskRelays.clockUs, command.alarmSinceUs);
+    }
+  }
+
+  void loopIteration(uint64_t nowUs) {
+    loopRelays.clockUs = nowUs;
+    loopMs = (uint32_t)(nowUs / 1000);
+
+    // readDeviceOutputs() and processLEDStatus()
+    LEDSnapshot snapshot;
+    while (snapshotRing.pop(snapshot)) {
+      alarmSinceUs = snapshot.timestampUs - snapshot.detectionLatencyUs;
+      LEDAlarmResult alarms = ledAlarms.apply(snapshot.word, loopMs, *this);
+      ledStatusText.format(snapshot.word, alarms);
+    }
+    alarmSinceUs = nowUs;
+    ledAlarms.refresh(loopMs, *this);
+
+    // Lift mode: a release stops
+    buttonPanel.update(buttonReading[0], buttonReading[1], false, loopMs, [this](uint8_t opcode) {
+      uint32_t gapUs;
+      buttonRelays.execute(opcode, gapUs);
+    });
+  }
+};
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::printf("usage: %s <scenario.txt>\n", argv[0]);
+    return 2;
+  }
+  Scenario scenario;
+  if (!parseScenario(argv[1], scenario)) return 2;
+
+  SimController controller(scenario);
+  controller.run();
+  for (const auto& metric : controller.metrics) {
+    std::printf("%-22s %lld\n", metric.first.c_str(), metric.second);
+  }
+
+  // Alert metrics only exist once the code has been published
+  for (const Expectation& expectation : scenario.expectations) {
+    auto found = controller.metrics.find(expectation.metric);
+    bool absent = found == controller.metrics.end();
+    long long actual = absent ? 0 : found->second;
+    bool ok = !absent && ((expectation.op == "<=" && actual <= expectation.value) ||
+                          (expectation.op == ">=" && actual >= expectation.value) ||
+                          (expectation.op == "==" && actual == expectation.value));
+    if (!ok) {
+      std::printf("%s:%d: regression: %s = %s, expected %s %lld\n", argv[1], expectation.line,
+                  expectation.metric.c_str(), absent ? "(none)" : std::to_string(actual).c_str(),
+                  expectation.op.c_str(), expectation.value);
+      testFailures++;
+    }
+  }
+  const char* name = strrchr(argv[1], '/');
+  return testResult(name ? name + 1 : argv[1]);
+}
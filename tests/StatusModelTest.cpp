@@ -0,0 +1,114 @@
+// Boot id round trip between "boot", the ETag and /status?boot=, section deltas, and the
+// chunked JSON writer
+
+#include <string>
+#include "TestUtil.h"
+#include "StatusModel.h"
+#include "MQTTPayload.h"
+
+static std::string output;
+static int chunks = 0;
+
+static void collect(const char* data, size_t length) {
+  output.append(data, length);
+  chunks++;
+}
+
+// What a client reads out of "boot" in a /status body
+static std::string bootField(uint32_t bootId) {
+  output.clear();
+  JsonChunkWriter json(collect);
+  char boot[STATUS_BOOT_ID_SIZE];
+  formatBootId(boot, sizeof(boot), bootId);
+  json.beginObject();
+  json.key("boot");
+  json.string(boot);
+  json.endObject();
+  json.flush();
+  size_t start = output.find("\"boot\":\"") + 8;
+  return output.substr(start, output.find('"', start) - start);
+}
+
+int main() {
+  // Every boot id a client echoes back parses to the same id, including ones whose
+  // decimal and hex spellings differ
+  const uint32_t bootIds[] = {0, 1, 9, 10, 16, 255, 4096, 123456, 0x7FFFFFFF, 0xFFFFFFFF};
+  for (uint32_t bootId : bootIds) {
+    std::string echoed = bootField(bootId);
+    CHECK_EQ(echoed.size(), 8);
+    uint32_t parsed = 0;
+    CHECK(parseBootId(echoed.c_str(), parsed));
+    CHECK_EQ(parsed, bootId);
+
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%s-%lu\"", echoed.c_str(), 42ul);
+    CHECK(std::string(etag).compare(1, 8, echoed) == 0);
+  }
+  uint32_t parsed = 7;
+  CHECK(!parseBootId("", parsed));
+  CHECK(!parseBootId(nullptr, parsed));
+  CHECK(!parseBootId("12g", parsed));
+  CHECK(!parseBootId("123456789", parsed));
+  CHECK_EQ(parsed, 7);
+  CHECK(parseBootId("a", parsed));
+  CHECK_EQ(parsed, 10);
+
+  // Sections changed after a sequence; everything for a new client or another boot's sequence
+  StatusModel model;
+  model.setMode(true, 500);
+  uint32_t afterMode = model.sequence();
+  model.setLedStatus("RED LED 1: ON");
+  model.setLedStatus("RED LED 1: ON");
+  model.setAlarms("R02", nullptr, nullptr);
+  CHECK_EQ(model.sequence(), afterMode + 2);
+  CHECK_EQ(model.changedSince(afterMode),
+           STATUS_SECTION_BIT(StatusSection::Leds) | STATUS_SECTION_BIT(StatusSection::Alarms));
+  CHECK_EQ(model.changedSince(model.sequence()), 0);
+  CHECK_EQ(model.changedSince(0), STATUS_ALL_SECTIONS);
+  CHECK_EQ(model.changedSince(model.sequence() + 1), STATUS_ALL_SECTIONS);
+
+  // Strings written in pieces are escaped like whole ones, and long output goes out in
+  // JSON_CHUNK_SIZE pieces
+  output.clear();
+  chunks = 0;
+  {
+    JsonChunkWriter json(collect);
+    json.beginObject();
+    json.key("logs");
+    json.beginString();
+    for (int i = 0; i < 100; i++) {
+      json.stringPart("[2026-01-01 00:00:00] ");
+      json.stringPart("say \"up\"\tnow\\");
+      json.stringPart("\n");
+    }
+    json.endString();
+    json.key("seq");
+    json.number(3);
+    json.endObject();
+    json.flush();
+    CHECK_EQ(json.bytesWritten(), output.size());
+  }
+  std::string line = "[2026-01-01 00:00:00] say \\\"up\\\"\\tnow\\\\\\n";
+  std::string expected = "{\"logs\":\"";
+  for (int i = 0; i < 100; i++) expected += line;
+  expected += "\",\"seq\":3}";
+  CHECK(output == expected);
+  CHECK_EQ(chunks, (expected.size() + JSON_CHUNK_SIZE - 1) / JSON_CHUNK_SIZE);
+
+  // Control characters are escaped as MQTTPayload escapes them, not dropped
+  const char* control = "a\x01" "b\x1f\b\f\x7f\"\xc3\xa9";
+  output.clear();
+  {
+    JsonChunkWriter json(collect);
+    json.string(control);
+    json.flush();
+  }
+  CHECK(output == "\"a\\u0001b\\u001f\\b\\f\x7f\\\"\xc3\xa9\"");
+  MQTTPayload payload;
+  payload.begin();
+  payload.add("m", control);
+  payload.finish();
+  CHECK(std::string(payload.c_str()) == "{\"m\":" + output + "}");
+
+  return testResult("StatusModelTest");
+}
@@ -0,0 +1,47 @@
+// TestUtil.h - Minimal check macros and timing for the host tests and benchmarks
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+static int testFailures = 0;
+
+#define CHECK(cond)                                                      \
+  do {                                                                   \
+    if (!(cond)) {                                                       \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      testFailures++;                                                    \
+    }                                                                    \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                                  \
+  do {                                                                                  \
+    long long checkA = (long long)(a), checkB = (long long)(b);                         \
+    if (checkA != checkB) {                                                             \
+      std::printf("%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, \
+                  #a, #b, checkA, checkB);                                              \
+      testFailures++;                                                                   \
+    }                                                                                   \
+  } while (0)
+
+inline int testResult(const char* name) {
+  if (testFailures == 0) std::printf("%s: all checks passed\n", name);
+  else std::printf("%s: %d checks failed\n", name, testFailures);
+  return testFailures == 0 ? 0 : 1;
+}
+
+inline uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimizer from discarding a benchmarked result
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // TEST_UTIL_H